@@ -0,0 +1,432 @@
+﻿// 统一的性能测试：把仓库中各个基础版本、优化版本以及库中的各内核链接到一起，
+// 按消息长度16B～1GB逐一测量，输出cycles/byte（rdtsc）、单次耗时的分位数与吞吐量，并写出JSON便于版本间比较
+#include "../project1/sm4.h"
+#include "../project1/sm4_gcm.h"
+#include "../project4/sm3.h"
+#include "../project4/sm3_hmac.h"
+#include "../project4/sm3_mb.h"
+#include "legacy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(SM4_X86)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+static const uint8_t KEY[16] = {
+    0x01,0x23,0x45,0x67, 0x89,0xab,0xcd,0xef,
+    0xfe,0xdc,0xba,0x98, 0x76,0x54,0x32,0x10
+};
+static const uint8_t IV[16] = { 0 };
+
+// x86上为时间戳计数器（按标称频率计数，与睿频无关），其他平台退化为纳秒
+static inline uint64_t ticks() {
+#if defined(SM4_X86)
+    return __rdtsc();
+#else
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 一个被测实现：prepare在计时前调用（切换内核等），run处理in中的全部数据
+struct variant {
+    string group;
+    string name;
+    size_t granularity;     // 消息长度须为其倍数（ECB/CBC为16）
+    function<void()> prepare;
+    function<void(const vector<uint8_t>& in, vector<uint8_t>& out)> run;
+};
+
+struct result {
+    string group, name;
+    size_t size;
+    size_t samples;
+    double cycles_per_byte;
+    double p50_ns, p90_ns, p99_ns, min_ns;
+    double mb_per_s;
+};
+
+struct options {
+    size_t min_size = 16;
+    size_t max_size = (size_t)1 << 30;
+    double time_per_point = 0.3;    // 每个(实现, 长度)至少测量的秒数
+    double max_run = 3.0;           // 预计单次超过该秒数的长度不再测量
+    string filter;
+    string json = "bench_results.json";
+};
+
+static options parse_args(int argc, char** argv) {
+    options o;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        auto next = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << "missing value for " << a << endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (a == "--min-size") o.min_size = strtoull(next().c_str(), nullptr, 0);
+        else if (a == "--max-size") o.max_size = strtoull(next().c_str(), nullptr, 0);
+        else if (a == "--time") o.time_per_point = atof(next().c_str());
+        else if (a == "--max-run") o.max_run = atof(next().c_str());
+        else if (a == "--filter") o.filter = next();
+        else if (a == "--json") o.json = next();
+        else {
+            cerr << "usage: bench_all [--min-size N] [--max-size N] [--time SEC] [--max-run SEC]"
+                " [--filter SUBSTR] [--json FILE]" << endl;
+            exit(2);
+        }
+    }
+    return o;
+}
+
+// 逐分组调用单分组加密函数的ECB
+template <class F>
+static void ecb_blocks(F encrypt, const vector<uint8_t>& in, vector<uint8_t>& out) {
+    for (size_t i = 0; i + 16 <= in.size(); i += 16) encrypt(&in[i], &out[i]);
+}
+
+// 批处理接口的记录长度：输入按该长度切成互相独立的记录
+static const size_t RECORD_BYTES = 1024;
+
+static vector<variant> make_variants() {
+    static uint32_t rk_basic[32], rk_ttable[32], rk_gcm_basic[32], rk_gcm[32];
+    static sm4_ctx ctx;
+    static sm4_xts_ctx xts;
+    static sm4_gcm_key gcm_key;
+    static const vector<uint8_t> gcm_iv(IV, IV + 12);
+    static uint8_t tag[16];
+    static uint8_t digest[32];
+
+    legacy_sm4_basic::key_expansion(KEY, rk_basic);
+    legacy_sm4_ttable::init_T_table();
+    legacy_sm4_ttable::key_expansion(KEY, rk_ttable);
+    legacy_gcm_basic::expand(KEY, rk_gcm_basic);
+    legacy_gcm::init_T();
+    legacy_gcm::init_R_table();
+    legacy_gcm::expand(KEY, rk_gcm);
+    sm4_set_key(&ctx, KEY);
+    uint8_t xts_key[32];
+    for (int i = 0; i < 32; i++) xts_key[i] = (uint8_t)(i * 7 + 1);     // 两半密钥必须不同
+    sm4_xts_set_key(&xts, xts_key);
+    sm4_gcm_set_key(&gcm_key, KEY);
+
+    static const string default_sm4 = sm4_impl_name();
+    static const string default_ghash = sm4_ghash_impl_name();
+    static const string default_sm3 = sm3_impl_name();
+    static const string default_mb = sm3_mb_impl_name();
+    auto restore = [] {
+        sm4_set_impl(default_sm4.c_str());
+        sm4_ghash_set_impl(default_ghash.c_str());
+        sm3_set_impl(default_sm3.c_str());
+        sm3_mb_set_impl(default_mb.c_str());
+    };
+
+    vector<variant> v;
+
+    // SM4单分组：原有程序逐分组调用，库按内核批量处理
+    v.push_back({ "sm4", "basic", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        ecb_blocks([](const uint8_t* a, uint8_t* b) { legacy_sm4_basic::sm4_encrypt_basic(a, b, rk_basic); }, in, out);
+    } });
+    v.push_back({ "sm4", "ttable-legacy", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        ecb_blocks([](const uint8_t* a, uint8_t* b) { legacy_sm4_ttable::sm4_encrypt(a, b, rk_ttable); }, in, out);
+    } });
+    v.push_back({ "sm4", "project1-b-basic", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        ecb_blocks([](const uint8_t* a, uint8_t* b) { legacy_gcm_basic::encrypt(a, b, rk_gcm_basic); }, in, out);
+    } });
+    v.push_back({ "sm4", "project1-b", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        ecb_blocks([](const uint8_t* a, uint8_t* b) { legacy_gcm::encrypt(a, b, rk_gcm); }, in, out);
+    } });
+    for (const char* impl : { "ttable", "bitslice", "bitslice-avx2", "aesni", "aesni-avx2", "gfni" }) {
+        if (!sm4_set_impl(impl)) continue;
+        string name = impl;
+        v.push_back({ "sm4", "lib-" + name, 16, [name] { sm4_set_impl(name.c_str()); },
+            [](const vector<uint8_t>& in, vector<uint8_t>& out) { sm4_ecb_encrypt(&ctx, in.data(), out.data(), in.size() / 16); } });
+    }
+    restore();
+    v.push_back({ "sm4", "lib-mt", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_ecb_encrypt_mt(&ctx, in.data(), out.data(), in.size() / 16);
+    } });
+
+    // CBC加密（解密可并行，单独列出）
+    v.push_back({ "cbc", "basic", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        legacy_sm4_basic::cbc_encrypt_basic(in, out, rk_basic, IV);
+    } });
+    v.push_back({ "cbc", "ttable-legacy", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        legacy_sm4_ttable::cbc_encrypt(in, out, rk_ttable, IV);
+    } });
+    v.push_back({ "cbc", "lib-encrypt", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        uint8_t iv[16];
+        memcpy(iv, IV, 16);
+        sm4_cbc_encrypt(&ctx, iv, in.data(), out.data(), in.size() / 16);
+    } });
+    v.push_back({ "cbc", "lib-decrypt", 16, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        uint8_t iv[16];
+        memcpy(iv, IV, 16);
+        sm4_cbc_decrypt(&ctx, iv, in.data(), out.data(), in.size() / 16);
+    } });
+
+    // CTR（32位计数器）与XTS（512B、4KB扇区）
+    v.push_back({ "ctr", "lib", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        uint8_t counter[16];
+        memcpy(counter, IV, 16);
+        sm4_ctr_crypt(&ctx, counter, 32, in.data(), out.data(), in.size());
+    } });
+    v.push_back({ "ctr", "lib-mt", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        uint8_t counter[16];
+        memcpy(counter, IV, 16);
+        sm4_ctr_crypt_mt(&ctx, counter, 32, in.data(), out.data(), in.size());
+    } });
+    v.push_back({ "xts", "lib-512", 512, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_xts_encrypt_sectors(&xts, 0, 512, in.data(), out.data(), in.size() / 512);
+    } });
+    v.push_back({ "xts", "lib-4k", 4096, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_xts_encrypt_sectors(&xts, 0, 4096, in.data(), out.data(), in.size() / 4096);
+    } });
+    v.push_back({ "xts", "lib-4k-mt", 4096, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_xts_encrypt_sectors_mt(&xts, 0, 4096, in.data(), out.data(), in.size() / 4096);
+    } });
+
+    // GCM加密（project1-b的两个版本按原接口调用，其结果并非标准SM4-GCM）
+    v.push_back({ "gcm", "project1-b-basic", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        legacy_gcm_basic::GCM(rk_gcm_basic, gcm_iv, in, out, tag);
+    } });
+    v.push_back({ "gcm", "project1-b", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        legacy_gcm::GCM(rk_gcm, gcm_iv, in, out, tag);
+    } });
+    for (const char* impl : { "bitwise", "shoup4", "shoup8", "pclmul", "vpclmul" }) {
+        if (!sm4_ghash_set_impl(impl)) continue;
+        string name = impl;
+        v.push_back({ "gcm", "lib-" + name, 1, [name] {
+            sm4_set_impl(default_sm4.c_str());
+            sm4_ghash_set_impl(name.c_str());
+        }, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+            sm4_gcm_encrypt(&ctx, IV, 12, nullptr, 0, in.data(), out.data(), in.size(), tag);
+        } });
+    }
+    restore();
+    v.push_back({ "gcm", "lib-mt", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_gcm_encrypt_mt(&ctx, IV, 12, nullptr, 0, in.data(), out.data(), in.size(), tag);
+    } });
+    // 批处理：输入切成1KB的记录，每次提交64条
+    v.push_back({ "gcm", "lib-batch-1k", RECORD_BYTES, restore, [](const vector<uint8_t>& in, vector<uint8_t>& out) {
+        sm4_gcm_record recs[64];
+        size_t records = in.size() / RECORD_BYTES;
+        for (size_t i = 0; i < records; i += 64) {
+            size_t m = min(records - i, (size_t)64);
+            for (size_t j = 0; j < m; j++) {
+                size_t off = (i + j) * RECORD_BYTES;
+                recs[j] = sm4_gcm_record{ &gcm_key, IV, 12, nullptr, 0, in.data() + off, out.data() + off, RECORD_BYTES, {} };
+            }
+            sm4_gcm_encrypt_batch(recs, m, nullptr);
+        }
+    } });
+
+    // SM3
+    v.push_back({ "sm3", "basic", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>&) {
+        legacy_sm3_basic::hash(in.data(), in.size());
+    } });
+    v.push_back({ "sm3", "project4-a", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>&) {
+        legacy_sm3::hash(in.data(), in.size());
+    } });
+    for (const char* impl : { "ssse3", "scalar" }) {
+        if (!sm3_set_impl(impl)) continue;
+        string name = impl;
+        v.push_back({ "sm3", "lib-" + name, 1, [name, restore] {
+            restore();
+            sm3_set_impl(name.c_str());
+        }, [](const vector<uint8_t>& in, vector<uint8_t>&) { sm3_hash(in.data(), in.size(), digest); } });
+    }
+    restore();
+    // 多路SM3：输入切成1KB的互相独立的消息，每次提交256条
+    for (const char* impl : { "avx512-x16", "avx2-x8", "scalar" }) {
+        if (!sm3_mb_set_impl(impl)) continue;
+        string name = impl;
+        v.push_back({ "sm3", "lib-mb-" + name + "-1k", RECORD_BYTES, [name, restore] {
+            restore();
+            sm3_mb_set_impl(name.c_str());
+        }, [](const vector<uint8_t>& in, vector<uint8_t>&) {
+            sm3_job jobs[256];
+            size_t messages = in.size() / RECORD_BYTES;
+            for (size_t i = 0; i < messages; i += 256) {
+                size_t m = min(messages - i, (size_t)256);
+                for (size_t j = 0; j < m; j++) {
+                    jobs[j] = sm3_job();
+                    jobs[j].data = in.data() + (i + j) * RECORD_BYTES;
+                    jobs[j].len = RECORD_BYTES;
+                }
+                sm3_hash_batch(jobs, m);
+            }
+        } });
+    }
+    restore();
+
+    // HMAC-SM3：整段数据一条MAC；批处理时输入切成1KB的消息，每次256条
+    static const sm3_hmac_key hmac_key(KEY, sizeof(KEY));
+    v.push_back({ "hmac", "lib", 1, restore, [](const vector<uint8_t>& in, vector<uint8_t>&) {
+        hmac_key.mac(in.data(), in.size(), digest);
+    } });
+    v.push_back({ "hmac", "lib-batch-1k", RECORD_BYTES, restore, [](const vector<uint8_t>& in, vector<uint8_t>&) {
+        sm3_hmac_job jobs[256];
+        size_t messages = in.size() / RECORD_BYTES;
+        for (size_t i = 0; i < messages; i += 256) {
+            size_t m = min(messages - i, (size_t)256);
+            for (size_t j = 0; j < m; j++) {
+                jobs[j] = sm3_hmac_job();
+                jobs[j].data = in.data() + (i + j) * RECORD_BYTES;
+                jobs[j].len = RECORD_BYTES;
+            }
+            sm3_hmac_batch(hmac_key, jobs, m);
+        }
+    } });
+    return v;
+}
+
+// 反复运行直到累计time秒且至少3次，记录每次的耗时与时钟周期
+static result measure(const variant& var, const vector<uint8_t>& in, vector<uint8_t>& out, double time) {
+    var.run(in, out);   // 预热：缓存、页表以及各实现的延迟初始化
+
+    vector<double> ns;
+    vector<uint64_t> cycles;
+    double total = 0;
+    while ((total < time || ns.size() < 3) && ns.size() < 100000) {
+        auto t0 = chrono::steady_clock::now();
+        uint64_t c0 = ticks();
+        var.run(in, out);
+        uint64_t c1 = ticks();
+        double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+        ns.push_back(elapsed);
+        cycles.push_back(c1 - c0);
+        total += elapsed * 1e-9;
+    }
+
+    sort(ns.begin(), ns.end());
+    sort(cycles.begin(), cycles.end());
+    auto pct = [&](double q) { return ns[min(ns.size() - 1, (size_t)(q * ns.size()))]; };
+
+    result r;
+    r.group = var.group;
+    r.name = var.name;
+    r.size = in.size();
+    r.samples = ns.size();
+    r.cycles_per_byte = (double)cycles[cycles.size() / 2] / in.size();
+    r.p50_ns = pct(0.5);
+    r.p90_ns = pct(0.9);
+    r.p99_ns = pct(0.99);
+    r.min_ns = ns[0];
+    r.mb_per_s = in.size() / (r.p50_ns * 1e-9) / 1e6;
+    return r;
+}
+
+static string size_name(size_t size) {
+    if (size >= ((size_t)1 << 30)) return to_string(size >> 30) + " GB";
+    if (size >= ((size_t)1 << 20)) return to_string(size >> 20) + " MB";
+    if (size >= ((size_t)1 << 10)) return to_string(size >> 10) + " KB";
+    return to_string(size) + " B";
+}
+
+static string cpu_model() {
+    ifstream f("/proc/cpuinfo");
+    string line;
+    while (getline(f, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t p = line.find(':');
+            if (p != string::npos) return line.substr(p + 2);
+        }
+    }
+    return "unknown";
+}
+
+// 时间戳计数器的频率，用于把cycles/byte与耗时对应起来
+static double tick_ghz() {
+    auto t0 = chrono::steady_clock::now();
+    uint64_t c0 = ticks();
+    while (chrono::steady_clock::now() - t0 < chrono::milliseconds(100)) {
+    }
+    uint64_t c1 = ticks();
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+    return (c1 - c0) / ns;
+}
+
+static string json_escape(const string& s) {
+    string r;
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        if ((unsigned char)c >= 0x20) r += c;
+    }
+    return r;
+}
+
+static void write_json(const string& path, const vector<result>& results, double ghz) {
+    ofstream f(path);
+    f << fixed << setprecision(3);
+    f << "{\n  \"host\": {\n"
+        << "    \"cpu\": \"" << json_escape(cpu_model()) << "\",\n"
+        << "    \"tick_ghz\": " << ghz << ",\n"
+        << "    \"sm4_impl\": \"" << sm4_impl_name() << "\",\n"
+        << "    \"ghash_impl\": \"" << sm4_ghash_impl_name() << "\",\n"
+        << "    \"threads\": " << sm4_threads() << "\n  },\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const result& r = results[i];
+        f << "    {\"group\": \"" << r.group << "\", \"variant\": \"" << r.name << "\", \"size\": " << r.size
+            << ", \"samples\": " << r.samples << ", \"cycles_per_byte\": " << r.cycles_per_byte
+            << ", \"p50_ns\": " << r.p50_ns << ", \"p90_ns\": " << r.p90_ns << ", \"p99_ns\": " << r.p99_ns
+            << ", \"min_ns\": " << r.min_ns << ", \"mb_per_s\": " << r.mb_per_s << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    options opt = parse_args(argc, argv);
+    vector<variant> variants = make_variants();
+    double ghz = tick_ghz();
+    cout << "CPU: " << cpu_model() << ", tick " << fixed << setprecision(2) << ghz << " GHz, "
+        << sm4_threads() << " threads" << endl;
+
+    // 每个实现上一次测得的单字节耗时，用来估计下一个长度单次运行要多久
+    vector<double> ns_per_byte(variants.size(), 0);
+    vector<result> results;
+    for (size_t size = opt.min_size; size <= opt.max_size; size *= 4) {
+        vector<uint8_t> in(size), out(size);
+        for (size_t i = 0; i < size; i++) in[i] = (uint8_t)(i * 131 + 7);
+
+        cout << "\n" << size_name(size) << endl;
+        cout << left << setw(26) << "variant" << right << setw(10) << "cyc/B" << setw(12) << "p50 us"
+            << setw(12) << "p99 us" << setw(12) << "MB/s" << endl;
+        for (size_t i = 0; i < variants.size(); i++) {
+            const variant& var = variants[i];
+            string full = var.group + "/" + var.name;
+            if (!opt.filter.empty() && full.find(opt.filter) == string::npos) continue;
+            if (size % var.granularity) continue;
+            if (ns_per_byte[i] * size * 1e-9 > opt.max_run) {
+                cout << left << setw(26) << full << right << setw(10) << "skipped" << endl;
+                continue;
+            }
+            var.prepare();
+            result r = measure(var, in, out, opt.time_per_point);
+            ns_per_byte[i] = r.min_ns / size;
+            results.push_back(r);
+            cout << left << setw(26) << full << right << fixed << setprecision(2) << setw(10) << r.cycles_per_byte
+                << setprecision(3) << setw(12) << r.p50_ns / 1e3 << setw(12) << r.p99_ns / 1e3
+                << setprecision(1) << setw(12) << r.mb_per_s << endl;
+        }
+        if (size > opt.max_size / 4) break;
+    }
+
+    write_json(opt.json, results, ghz);
+    cout << "\nwrote " << results.size() << " results to " << opt.json << endl;
+    return 0;
+}
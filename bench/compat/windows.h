@@ -0,0 +1,24 @@
+﻿#pragma once
+// 仅供bench使用：在Linux上编译仓库中原有的Windows程序（它们只用到下面几个接口）
+#include <stdint.h>
+#include <time.h>
+
+typedef union {
+    long long QuadPart;
+} LARGE_INTEGER;
+
+static inline int QueryPerformanceFrequency(LARGE_INTEGER* f) {
+    f->QuadPart = 1000000000LL;
+    return 1;
+}
+
+static inline int QueryPerformanceCounter(LARGE_INTEGER* c) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->QuadPart = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return 1;
+}
+
+static inline unsigned long _byteswap_ulong(unsigned long x) {
+    return __builtin_bswap32((uint32_t)x);
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+// 仓库中原有的单文件程序（基础版本与优化版本），由legacy_sm4.cpp / legacy_sm3.cpp
+// 放进各自的命名空间编译，main被改名，不会与库的符号冲突
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// project1/基础SM4实现.cpp
+namespace legacy_sm4_basic {
+void key_expansion(const uint8_t key[16], uint32_t rk[32]);
+void sm4_encrypt_basic(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]);
+void cbc_encrypt_basic(const std::vector<uint8_t>& plaintext, std::vector<uint8_t>& ciphertext,
+    const uint32_t rk[32], const uint8_t iv[16]);
+}
+
+// project1/T-table优化.cpp
+namespace legacy_sm4_ttable {
+void init_T_table();
+void key_expansion(const uint8_t key[16], uint32_t rk[32]);
+void sm4_encrypt(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]);
+void cbc_encrypt(const std::vector<uint8_t>& plaintext, std::vector<uint8_t>& ciphertext,
+    const uint32_t rk[32], const uint8_t iv[16]);
+}
+
+// project1/project1-b-基础版本.cpp
+namespace legacy_gcm_basic {
+void expand(const uint8_t key[16], uint32_t rk[32]);
+void encrypt(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]);
+void GCM(const uint32_t rk[32], const std::vector<uint8_t>& IV, const std::vector<uint8_t>& plaintext,
+    std::vector<uint8_t>& ciphertext, uint8_t res[16]);
+}
+
+// project1/project1-b.cpp
+namespace legacy_gcm {
+void init_T();
+void init_R_table();
+void expand(const uint8_t key[16], uint32_t rk[32]);
+void encrypt(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]);
+void GCM(const uint32_t rk[32], const std::vector<uint8_t>& IV, const std::vector<uint8_t>& plaintext,
+    std::vector<uint8_t>& ciphertext, uint8_t res[16]);
+}
+
+// project4/project4-a-基础版本.cpp与project4/project4-a.cpp的SM3类：update整段数据、finalize后取十六进制摘要
+namespace legacy_sm3_basic {
+std::string hash(const uint8_t* data, size_t len);
+}
+namespace legacy_sm3 {
+std::string hash(const uint8_t* data, size_t len);
+}
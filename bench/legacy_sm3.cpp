@@ -0,0 +1,35 @@
+﻿// project4中的两个SM3程序。优化版本用宏定义了FF0、P0等名字，必须在基础版本之后包含
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "legacy.h"
+
+#define main legacy_main
+namespace legacy_sm3_basic {
+#include "../project4/project4-a-基础版本.cpp"
+
+std::string hash(const uint8_t* data, size_t len) {
+    SM3 sm3;
+    sm3.update(data, len);
+    sm3.finalize();
+    return sm3.digest();
+}
+}
+namespace legacy_sm3 {
+#include "../project4/project4-a.cpp"
+
+std::string hash(const uint8_t* data, size_t len) {
+    SM3 sm3;
+    sm3.update(data, len);
+    sm3.finalize();
+    return sm3.digest();
+}
+}
+#undef main
@@ -0,0 +1,25 @@
+﻿// 把project1中原有的四个SM4程序放进各自的命名空间编译；
+// 标准头文件先在全局包含，文件内的#include因头文件保护不再展开
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+#define main legacy_main
+namespace legacy_sm4_basic {
+#include "../project1/基础SM4实现.cpp"
+}
+namespace legacy_sm4_ttable {
+#include "../project1/T-table优化.cpp"
+}
+namespace legacy_gcm_basic {
+#include "../project1/project1-b-基础版本.cpp"
+}
+namespace legacy_gcm {
+#include "../project1/project1-b.cpp"
+}
+#undef main
@@ -0,0 +1,13 @@
+﻿#pragma once
+// x86内建函数头文件。GCC 12的AVX-512头文件中_mm512_undefined_*在内联后会触发
+// -Wuninitialized / -Wmaybe-uninitialized误报，只对这个头文件关闭这两项警告，
+// 各实现文件中自己的代码仍照常检查
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
@@ -0,0 +1,285 @@
+﻿#include "probe.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const int FIELDS = 7;    // 与probe_stats的成员一一对应
+static const int HW_EVENTS = 3;
+
+static inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 每个线程一份计数：只有所属线程写入（relaxed的读-加-写，没有锁前缀），快照线程用relaxed读取
+struct thread_counters {
+    atomic<uint64_t> v[PROBE_COUNT][FIELDS];
+    int fd[HW_EVENTS];
+#if defined(__linux__)
+    perf_event_mmap_page* page[HW_EVENTS];
+#endif
+    unsigned hw_generation;     // 上一次按全局开关打开/关闭计数器时的代数
+    bool hw_ready;
+
+    thread_counters();
+    ~thread_counters();
+    void add(probe_point p, const uint64_t f[FIELDS]) {
+        for (int i = 0; i < FIELDS; i++) {
+            v[p][i].store(v[p][i].load(memory_order_relaxed) + f[i], memory_order_relaxed);
+        }
+    }
+    void open_hw();
+    void close_hw();
+    bool read_hw(uint64_t out[HW_EVENTS]) const;
+};
+
+// 活动线程列表与已退出线程的累计值；有意不释放，避免与线程局部对象的析构顺序冲突
+struct registry {
+    mutex m;
+    vector<thread_counters*> live;
+    uint64_t retired[PROBE_COUNT][FIELDS] = {};
+    uint64_t baseline[PROBE_COUNT][FIELDS] = {};
+};
+
+static registry& reg() {
+    static registry* r = new registry;
+    return *r;
+}
+
+static atomic<bool> hw_wanted{ getenv("CRYPTO_PROBE_HW") != nullptr && strcmp(getenv("CRYPTO_PROBE_HW"), "0") != 0 };
+static atomic<unsigned> hw_generation{ 1 };
+
+thread_counters::thread_counters() : hw_generation(0), hw_ready(false) {
+    for (auto& p : v) {
+        for (auto& x : p) x.store(0, memory_order_relaxed);
+    }
+    for (int i = 0; i < HW_EVENTS; i++) {
+        fd[i] = -1;
+#if defined(__linux__)
+        page[i] = nullptr;
+#endif
+    }
+    registry& r = reg();
+    lock_guard<mutex> lock(r.m);
+    r.live.push_back(this);
+}
+
+thread_counters::~thread_counters() {
+    close_hw();
+    registry& r = reg();
+    lock_guard<mutex> lock(r.m);
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        for (int i = 0; i < FIELDS; i++) r.retired[p][i] += v[p][i].load(memory_order_relaxed);
+    }
+    for (size_t i = 0; i < r.live.size(); i++) {
+        if (r.live[i] == this) {
+            r.live[i] = r.live.back();
+            r.live.pop_back();
+            break;
+        }
+    }
+}
+
+#if defined(__linux__)
+static int perf_open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// 每个事件单独打开并映射元数据页：CPU允许时用rdpmc在用户态读取（几十个周期），否则退回read系统调用
+void thread_counters::open_hw() {
+#if defined(__linux__)
+    static const uint32_t type[HW_EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+    static const uint64_t config[HW_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < HW_EVENTS; i++) {
+        fd[i] = perf_open(type[i], config[i]);
+        if (fd[i] < 0) {
+            close_hw();
+            return;
+        }
+        void* p = mmap(nullptr, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd[i], 0);
+        page[i] = p == MAP_FAILED ? nullptr : static_cast<perf_event_mmap_page*>(p);
+    }
+    hw_ready = true;
+#endif
+}
+
+void thread_counters::close_hw() {
+    for (int i = 0; i < HW_EVENTS; i++) {
+#if defined(__linux__)
+        if (page[i]) munmap(page[i], (size_t)sysconf(_SC_PAGESIZE));
+        page[i] = nullptr;
+        if (fd[i] >= 0) close(fd[i]);
+#endif
+        fd[i] = -1;
+    }
+    hw_ready = false;
+}
+
+bool thread_counters::read_hw(uint64_t out[HW_EVENTS]) const {
+#if defined(__linux__)
+    for (int i = 0; i < HW_EVENTS; i++) {
+        const volatile perf_event_mmap_page* pc = page[i];
+        bool done = false;
+#if defined(__x86_64__) || defined(__i386__)
+        // 内核文档中的用户态读取协议：lock为序列号，index非0时计数器正在该PMC上运行
+        if (pc && pc->cap_user_rdpmc) {
+            uint32_t seq, idx;
+            uint64_t count;
+            do {
+                seq = pc->lock;
+                atomic_signal_fence(memory_order_seq_cst);
+                idx = pc->index;
+                count = pc->offset;
+                if (idx) {
+                    uint32_t width = pc->pmc_width;
+                    int64_t pmc = (int64_t)__rdpmc((int)idx - 1);
+                    pmc <<= 64 - width;
+                    pmc >>= 64 - width;
+                    count += pmc;
+                }
+                atomic_signal_fence(memory_order_seq_cst);
+            } while (pc->lock != seq);
+            if (idx) {
+                out[i] = count;
+                done = true;
+            }
+        }
+#endif
+        if (!done && read(fd[i], &out[i], sizeof(uint64_t)) != (ssize_t)sizeof(uint64_t)) return false;
+    }
+    return true;
+#else
+    (void)out;
+    return false;
+#endif
+}
+
+static thread_counters& local() {
+    static thread_local thread_counters t;
+    return t;
+}
+
+// 全局开关变化后，各线程在下一次进入插桩点时打开或关闭自己的计数器
+static thread_counters& local_synced() {
+    thread_counters& t = local();
+    unsigned g = hw_generation.load(memory_order_relaxed);
+    if (t.hw_generation != g) {
+        t.hw_generation = g;
+        if (hw_wanted.load() && !t.hw_ready) t.open_hw();
+        else if (!hw_wanted.load() && t.hw_ready) t.close_hw();
+    }
+    return t;
+}
+
+const char* probe_point_name(probe_point p) {
+    static const char* names[PROBE_COUNT] = { "sm4", "cbc", "ghash", "gcm", "sm3_update", "sm3_block" };
+    return p < PROBE_COUNT ? names[p] : "unknown";
+}
+
+bool probe_enable_hw(bool on) {
+    hw_wanted = on;
+    hw_generation++;
+    return local_synced().hw_ready == on;
+}
+
+static void sum(uint64_t out[PROBE_COUNT][FIELDS]) {
+    registry& r = reg();
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        for (int i = 0; i < FIELDS; i++) out[p][i] = r.retired[p][i];
+    }
+    for (thread_counters* t : r.live) {
+        for (int p = 0; p < PROBE_COUNT; p++) {
+            for (int i = 0; i < FIELDS; i++) out[p][i] += t->v[p][i].load(memory_order_relaxed);
+        }
+    }
+}
+
+probe_snapshot probe_take_snapshot() {
+    bool hw = local_synced().hw_ready;
+    uint64_t total[PROBE_COUNT][FIELDS];
+    registry& r = reg();
+    lock_guard<mutex> lock(r.m);
+    sum(total);
+
+    probe_snapshot s;
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        uint64_t f[FIELDS];
+        for (int i = 0; i < FIELDS; i++) f[i] = total[p][i] - r.baseline[p][i];
+        s.points[p] = probe_stats{ f[0], f[1], f[2], f[3], f[4], f[5], f[6] };
+    }
+    s.hw = hw;
+    return s;
+}
+
+void probe_reset() {
+    registry& r = reg();
+    lock_guard<mutex> lock(r.m);
+    sum(r.baseline);
+}
+
+string probe_to_json(const probe_snapshot& s) {
+    string out = string("{\"hw\": ") + (s.hw ? "true" : "false") + ", \"points\": {";
+    char line[320];
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        const probe_stats& st = s.points[p];
+        snprintf(line, sizeof(line),
+            "%s\n  \"%s\": {\"calls\": %llu, \"bytes\": %llu, \"blocks\": %llu, \"tsc\": %llu, "
+            "\"cycles\": %llu, \"l1d_misses\": %llu, \"branch_misses\": %llu}",
+            p ? "," : "", probe_point_name((probe_point)p),
+            (unsigned long long)st.calls, (unsigned long long)st.bytes, (unsigned long long)st.blocks,
+            (unsigned long long)st.tsc, (unsigned long long)st.cycles,
+            (unsigned long long)st.l1d_misses, (unsigned long long)st.branch_misses);
+        out += line;
+    }
+    out += "\n}}";
+    return out;
+}
+
+#if defined(CRYPTO_PROBE)
+probe_scope::probe_scope(probe_point p, uint64_t bytes, uint64_t blocks)
+    : point(p), bytes(bytes), blocks(blocks) {
+    thread_counters& t = local_synced();
+    hw_on = t.hw_ready && t.read_hw(hw);
+    tsc = read_tsc();
+}
+
+probe_scope::~probe_scope() {
+    uint64_t end = read_tsc();
+    uint64_t f[FIELDS] = { 1, bytes, blocks, end - tsc, 0, 0, 0 };
+    thread_counters& t = local();
+    uint64_t now[HW_EVENTS];
+    if (hw_on && t.read_hw(now)) {
+        for (int i = 0; i < HW_EVENTS; i++) f[4 + i] = now[i] - hw[i];
+    }
+    t.add(point, f);
+}
+#endif
@@ -0,0 +1,71 @@
+﻿#pragma once
+// 热点函数的插桩：统计各入口的调用次数、字节数、分组数与时间戳计数器（rdtsc）周期，
+// 可选读取Linux perf_event_open硬件计数器（核心周期、L1D读缺失、分支预测失败），并导出快照。
+// 只有定义了CRYPTO_PROBE时PROBE宏才展开成计数代码；未定义时宏为空，库中不留任何指令，也不需要链接probe.cpp
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum probe_point {
+    PROBE_SM4,          // sm4_crypt_blocks（ECB/CTR/XTS等批量加解密的公共入口，单分组sm4_encrypt_block/sm4_decrypt_block也经由它）
+    PROBE_CBC,          // sm4_cbc_encrypt / sm4_cbc_decrypt
+    PROBE_GHASH,        // sm4_ghash_update（GHASH()经由它）
+    PROBE_GCM,          // sm4_gcm_update与批处理接口（一次完成的GCM、多线程GCM均经由sm4_gcm_update）
+    PROBE_SM3_UPDATE,   // SM3::update
+    PROBE_SM3_BLOCK,    // SM3::process_blocks（每次调用压缩连续的若干分组）
+    PROBE_COUNT
+};
+
+// 各计数均为包含关系：例如GCM的周期中包含它调用的SM4与GHASH
+struct probe_stats {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t blocks;
+    uint64_t tsc;               // rdtsc差值之和（按标称频率计数）
+    uint64_t cycles;            // 以下三项只在启用硬件计数器后累计，只计用户态
+    uint64_t l1d_misses;
+    uint64_t branch_misses;
+};
+
+struct probe_snapshot {
+    probe_stats points[PROBE_COUNT];
+    bool hw;                    // 调用线程上硬件计数器是否可用
+};
+
+const char* probe_point_name(probe_point p);
+
+// 启用/关闭硬件计数器（也可设置环境变量CRYPTO_PROBE_HW=1）。各线程在下一次进入插桩点时打开自己的计数器；
+// 内核不允许（perf_event_paranoid、虚拟机无PMU）时保持关闭，只统计软件计数
+bool probe_enable_hw(bool on);
+
+// 汇总所有线程（包括已退出线程）的计数，减去上一次probe_reset时的值
+probe_snapshot probe_take_snapshot();
+void probe_reset();
+
+// 快照导出为JSON对象，每个插桩点一项
+std::string probe_to_json(const probe_snapshot& s);
+
+#if defined(CRYPTO_PROBE)
+// 作用域计时：构造时记录起点，析构时把本次调用累加到当前线程的计数中
+class probe_scope {
+public:
+    probe_scope(probe_point p, uint64_t bytes, uint64_t blocks);
+    ~probe_scope();
+
+    probe_scope(const probe_scope&) = delete;
+    probe_scope& operator=(const probe_scope&) = delete;
+
+private:
+    probe_point point;
+    uint64_t bytes, blocks;
+    uint64_t tsc;
+    uint64_t hw[3];
+    bool hw_on;
+};
+
+#define PROBE_CAT2(a, b) a##b
+#define PROBE_CAT(a, b) PROBE_CAT2(a, b)
+#define PROBE(point, bytes, blocks) probe_scope PROBE_CAT(probe_scope_, __LINE__)((point), (bytes), (blocks))
+#else
+#define PROBE(point, bytes, blocks) ((void)0)
+#endif
@@ -0,0 +1,539 @@
+﻿#include "sm4.h"
+#include "sm4_drbg.h"
+#include "sm4_key_cache.h"
+#include "sm4_tables.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(SM4_X86)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// 标准测试向量（GM/T 0002-2012 附录A）
+static const uint8_t MK[16] = {
+    0x01,0x23,0x45,0x67, 0x89,0xab,0xcd,0xef,
+    0xfe,0xdc,0xba,0x98, 0x76,0x54,0x32,0x10
+};
+static const uint8_t expected[16] = {
+    0x68,0x1e,0xdf,0x34, 0xd2,0x06,0x96,0x5e,
+    0x86,0xb3,0xe9,0x4f, 0x53,0x6e,0x42,0x46
+};
+
+struct kernel {
+    const char* name;
+    sm4_blocks_fn fn;
+    bool available;
+};
+
+// 逐分组的CTR参考实现：对计数器分组的最后ctr_bits/8个字节做大端序加一
+static void ctr_reference(const uint32_t rk[32], uint8_t counter[16], int ctr_bits,
+    const uint8_t* in, uint8_t* out, size_t len) {
+    for (size_t off = 0; off < len; off += 16) {
+        uint8_t S[16];
+        sm4_encrypt(counter, S, rk);
+        for (size_t i = 0; i < 16 && off + i < len; i++) out[off + i] = in[off + i] ^ S[i];
+        for (int i = 15; i >= 16 - ctr_bits / 8; i--) {
+            if (++counter[i] != 0) break;
+        }
+    }
+}
+
+// 逐分组的CTR_DRBG参考实现（SP 800-90A，无派生函数），V按128位大端整数逐字节加一
+struct drbg_reference {
+    sm4_ctx K;
+    uint8_t V[16] = { 0 };
+
+    explicit drbg_reference(const uint8_t seed[32]) {
+        uint8_t zero[16] = { 0 };
+        sm4_set_key(&K, zero);
+        update(seed);
+    }
+    void inc() {
+        for (int i = 15; i >= 0; i--) {
+            if (++V[i] != 0) break;
+        }
+    }
+    void update(const uint8_t provided[32]) {
+        uint8_t temp[32];
+        for (int i = 0; i < 2; i++) {
+            inc();
+            sm4_encrypt(V, temp + 16 * i, K.rk_enc);
+        }
+        for (int i = 0; i < 32; i++) temp[i] ^= provided[i];
+        sm4_set_key(&K, temp);
+        memcpy(V, temp + 16, 16);
+    }
+    void generate(uint8_t* out, size_t len) {
+        for (size_t off = 0; off < len; off += 16) {
+            uint8_t blk[16];
+            inc();
+            sm4_encrypt(V, blk, K.rk_enc);
+            memcpy(out + off, blk, len - off < 16 ? len - off : 16);
+        }
+        uint8_t zero[32] = { 0 };
+        update(zero);
+    }
+};
+
+// 逐分组的XTS参考实现（IEEE 1619）：tweak逐字节左移一位，最后两个分组按密文窃取处理
+static void xts_reference(const uint32_t rk1[32], const uint32_t rk2[32], bool enc, const uint8_t iv[16],
+    const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t T[16];
+    sm4_encrypt(iv, T, rk2);
+    auto next = [](uint8_t t[16]) {
+        uint8_t carry = 0;
+        for (int i = 0; i < 16; i++) {
+            uint8_t c = t[i] >> 7;
+            t[i] = static_cast<uint8_t>((t[i] << 1) | carry);
+            carry = c;
+        }
+        if (carry) t[0] ^= 0x87;
+    };
+    auto block = [&](const uint8_t t[16], const uint8_t* src, uint8_t* dst) {
+        uint8_t b[16];
+        for (int i = 0; i < 16; i++) b[i] = src[i] ^ t[i];
+        sm4_encrypt(b, b, rk1);
+        for (int i = 0; i < 16; i++) dst[i] = b[i] ^ t[i];
+    };
+    size_t m = len / 16, r = len % 16;
+    for (size_t i = 0; i + (r ? 1 : 0) < m; i++) {
+        block(T, in + 16 * i, out + 16 * i);
+        next(T);
+    }
+    if (r) {
+        uint8_t T2[16], cc[16], pp[16];
+        memcpy(T2, T, 16);
+        next(T2);
+        const uint8_t* p = in + 16 * (m - 1);
+        uint8_t* c = out + 16 * (m - 1);
+        block(enc ? T : T2, p, cc);
+        memcpy(pp, p + 16, r);
+        memcpy(pp + r, cc + r, 16 - r);
+        memcpy(c + 16, cc, r);
+        block(enc ? T2 : T, pp, c);
+    }
+}
+
+// 反复执行fn至少0.5秒，返回吞吐量(MB/s)
+template <class F>
+static double measure(size_t bytes, F fn) {
+    int iterations = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        iterations++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < 0.5);
+    return bytes * (double)iterations / elapsed / (1024.0 * 1024.0);
+}
+
+// 时间戳计数器；非x86平台退化为纳秒
+static inline uint64_t ticks() {
+#if defined(SM4_X86)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 每轮先执行prepare（不计时），再对fn计时，至少0.5秒，返回平均每字节的周期数
+template <class P, class F>
+static double measure_cycles(size_t bytes, P prepare, F fn) {
+    uint64_t cycles = 0, iterations = 0;
+    auto start = chrono::steady_clock::now();
+    do {
+        prepare();
+        uint64_t t0 = ticks();
+        fn();
+        cycles += ticks() - t0;
+        iterations++;
+    } while (chrono::duration<double>(chrono::steady_clock::now() - start).count() < 0.5);
+    return (double)cycles / (double)(iterations * bytes);
+}
+
+struct layout {
+    const char* name;
+    sm4_blocks_fn fn;
+    size_t table_bytes;
+};
+
+int main() {
+    uint32_t rk[32];
+    key_expansion(MK, rk);
+
+    kernel kernels[] = {
+        { "T-table", sm4_encrypt_blocks, true },
+        { "bitslice-64", sm4_encrypt_bitslice, true },
+        { "bitslice-avx2", sm4_encrypt_bitslice_avx2, sm4_cpu().avx2 },
+        { "aesni-x4", sm4_encrypt_aesni, sm4_cpu().aesni },
+        { "aesni-avx2-x8", sm4_encrypt_aesni_avx2, sm4_cpu().aesni && sm4_cpu().avx2 },
+        { "gfni-avx512-x16", sm4_encrypt_gfni, sm4_cpu().gfni && sm4_cpu().avx512 },
+    };
+
+    // 正确性：标准测试向量 + 与T-table实现逐字节比对
+    vector<uint8_t> data(16 * 1000 + 16 * 37);
+    mt19937 gen(2024);
+    for (auto& b : data) b = static_cast<uint8_t>(gen());
+    vector<uint8_t> ref(data.size());
+    sm4_encrypt_blocks(data.data(), ref.data(), data.size() / 16, rk);
+
+    for (const kernel& k : kernels) {
+        if (!k.available) continue;
+        uint8_t ct[16];
+        k.fn(MK, ct, 1, rk);
+        vector<uint8_t> out(data.size());
+        k.fn(data.data(), out.data(), data.size() / 16, rk);
+        bool ok = memcmp(ct, expected, 16) == 0 && out == ref;
+        cout << left << setw(18) << k.name << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // 统一接口：自动选择的内核加密后再解密应还原明文
+    sm4_ctx ctx;
+    sm4_set_key(&ctx, MK);
+    vector<uint8_t> ct(data.size()), pt(data.size());
+    sm4_ecb_encrypt(&ctx, data.data(), ct.data(), data.size() / 16);
+    sm4_ecb_decrypt(&ctx, ct.data(), pt.data(), data.size() / 16);
+    bool ok = ct == ref && pt == data;
+    cout << "\nDispatched kernel: " << sm4_impl_name() << (ok ? " (round trip correct)" : " (MISMATCH)") << endl;
+    if (!ok) return 1;
+
+    // CBC：原地解密、分两段解密都应还原明文
+    const uint8_t iv0[16] = { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f };
+    uint8_t iv[16];
+    size_t blocks = data.size() / 16;
+    memcpy(iv, iv0, 16);
+    sm4_cbc_encrypt(&ctx, iv, data.data(), ct.data(), blocks);
+    pt = ct;
+    memcpy(iv, iv0, 16);
+    sm4_cbc_decrypt(&ctx, iv, pt.data(), pt.data(), blocks);
+    ok = pt == data;
+    vector<uint8_t> pt2(data.size());
+    memcpy(iv, iv0, 16);
+    sm4_cbc_decrypt(&ctx, iv, ct.data(), pt2.data(), 300);
+    sm4_cbc_decrypt(&ctx, iv, ct.data() + 16 * 300, pt2.data() + 16 * 300, blocks - 300);
+    ok = ok && pt2 == data;
+    cout << "CBC round trip: " << (ok ? "correct" : "MISMATCH") << endl;
+    if (!ok) return 1;
+
+    // CTR：三种计数器宽度，计数器从即将回绕的位置开始，长度不是16的倍数
+    for (int bits : { 32, 64, 128 }) {
+        uint8_t c1[16], c2[16];
+        for (int i = 0; i < 16; i++) c1[i] = c2[i] = i < 8 ? 0x5a : 0xff;
+        c1[15] = c2[15] = 0xf0;
+        size_t len = data.size() - 5;
+        vector<uint8_t> a(len), b(len);
+        ctr_reference(ctx.rk_enc, c1, bits, data.data(), a.data(), len);
+        sm4_ctr_crypt(&ctx, c2, bits, data.data(), b.data(), len);
+        ok = a == b && memcmp(c1, c2, 16) == 0;
+        cout << "CTR" << bits << ": " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // 不支持的计数器宽度：返回false，数据与计数器保持不变（600KB原地加密，多线程接口会走到线程池的路径）
+    {
+        uint8_t c[16] = {}, c0[16] = {};
+        vector<uint8_t> o(600 * 1024, 0xAA), o0 = o;
+        ok = true;
+        for (int bits : { 0, 1, 16, 63, 65, 96, 127, 129, -32 }) {
+            ok = ok && !sm4_ctr_crypt(&ctx, c, bits, o.data(), o.data(), o.size())
+                && !sm4_ctr_crypt_mt(&ctx, c, bits, o.data(), o.data(), o.size())
+                && !sm4_ctr_add(c, bits, 1);
+        }
+        ok = ok && o == o0 && memcmp(c, c0, 16) == 0;
+        cout << "CTR invalid counter width: " << (ok ? "rejected" : "NOT REJECTED") << endl;
+        if (!ok) return 1;
+    }
+
+    // XTS：各种长度（含密文窃取）与参考实现比对；扇区接口与逐扇区调用一致
+    sm4_xts_ctx xts;
+    uint8_t xts_key[32];
+    for (int i = 0; i < 32; i++) xts_key[i] = static_cast<uint8_t>(i * 7 + 1);
+    sm4_xts_set_key(&xts, xts_key);
+    {
+        uint32_t rk1[32], rk2[32], rk1d[32];
+        key_expansion(xts_key, rk1);
+        key_expansion(xts_key + 16, rk2);
+        for (int i = 0; i < 32; i++) rk1d[i] = rk1[31 - i];
+        const uint8_t iv[16] = { 0x12,0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0 };
+        ok = true;
+        for (size_t len : { (size_t)16, (size_t)17, (size_t)31, (size_t)32, (size_t)4096 + 9, data.size() - 5 }) {
+            vector<uint8_t> a(len), b(len), c(len);
+            xts_reference(rk1, rk2, true, iv, data.data(), a.data(), len);
+            sm4_xts_encrypt(&xts, iv, data.data(), b.data(), len);
+            xts_reference(rk1d, rk2, false, iv, a.data(), c.data(), len);
+            ok = ok && a == b && memcmp(c.data(), data.data(), len) == 0;
+            sm4_xts_decrypt(&xts, iv, b.data(), b.data(), len);
+            ok = ok && memcmp(b.data(), data.data(), len) == 0;
+        }
+        for (size_t sector_size : { (size_t)512, (size_t)4096, (size_t)520 }) {
+            size_t sectors = data.size() / sector_size;
+            size_t len = sectors * sector_size;
+            vector<uint8_t> a(len), b(len);
+            for (size_t s = 0; s < sectors; s++) {
+                uint8_t siv[16] = { 0 };
+                uint64_t n = 0xfffffff0ULL + s;
+                for (int i = 0; i < 8; i++) siv[i] = static_cast<uint8_t>(n >> (8 * i));
+                xts_reference(rk1, rk2, true, siv, data.data() + s * sector_size, a.data() + s * sector_size, sector_size);
+            }
+            sm4_xts_encrypt_sectors(&xts, 0xfffffff0ULL, sector_size, data.data(), b.data(), sectors);
+            ok = ok && a == b;
+            sm4_xts_decrypt_sectors(&xts, 0xfffffff0ULL, sector_size, b.data(), b.data(), sectors);
+            ok = ok && memcmp(b.data(), data.data(), len) == 0;
+        }
+        cout << "XTS (with ciphertext stealing): " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+
+        // 两半相同的密钥、不足一个分组的数据单元与扇区都应报错，且不写输出
+        uint8_t same_key[32], out15[15];
+        for (int i = 0; i < 32; i++) same_key[i] = static_cast<uint8_t>(i % 16);
+        sm4_xts_ctx rejected = xts;
+        memset(out15, 0xAA, sizeof(out15));
+        ok = !sm4_xts_set_key(&rejected, same_key) && memcmp(&rejected, &xts, sizeof(xts)) == 0
+            && !sm4_xts_encrypt(&xts, iv, data.data(), out15, 15) && !sm4_xts_decrypt(&xts, iv, data.data(), out15, 15)
+            && !sm4_xts_encrypt_sectors(&xts, 0, 15, data.data(), out15, 1)
+            && !sm4_xts_decrypt_sectors_mt(&xts, 0, 15, data.data(), out15, 1);
+        for (uint8_t b : out15) ok = ok && b == 0xAA;
+        cout << "XTS invalid key / length: " << (ok ? "rejected" : "NOT REJECTED") << endl;
+        if (!ok) return 1;
+
+        // 公开测试向量：OpenSSL evpciph_sm4.txt中SM4-XTS的IEEE 1619形式（56字节，含密文窃取）。
+        // 密文窃取只影响最后两个分组，因此前32字节明文的密文就是该密文的前32字节，作为整分组的情况
+        static const uint8_t kat_key[32] = {
+            0x2b,0x7e,0x15,0x16,0x28,0xae,0xd2,0xa6,0xab,0xf7,0x15,0x88,0x09,0xcf,0x4f,0x3c,
+            0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f
+        };
+        static const uint8_t kat_iv[16] = {
+            0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa,0xfb,0xfc,0xfd,0xfe,0xff
+        };
+        static const uint8_t kat_pt[56] = {
+            0x6b,0xc1,0xbe,0xe2,0x2e,0x40,0x9f,0x96,0xe9,0x3d,0x7e,0x11,0x73,0x93,0x17,0x2a,
+            0xae,0x2d,0x8a,0x57,0x1e,0x03,0xac,0x9c,0x9e,0xb7,0x6f,0xac,0x45,0xaf,0x8e,0x51,
+            0x30,0xc8,0x1c,0x46,0xa3,0x5c,0xe4,0x11,0xe5,0xfb,0xc1,0x19,0x1a,0x0a,0x52,0xef,
+            0xf6,0x9f,0x24,0x45,0xdf,0x4f,0x9b,0x17
+        };
+        static const uint8_t kat_ct[56] = {
+            0xe9,0x53,0x82,0x51,0xc7,0x1d,0x7b,0x80,0xbb,0xe4,0x48,0x3f,0xef,0x49,0x7b,0xd1,
+            0xb3,0xdb,0x1a,0x3e,0x60,0x40,0x8c,0x57,0x5d,0x63,0xff,0x7d,0xb3,0x9f,0x83,0x26,
+            0x08,0x69,0xf9,0xe2,0x58,0x5f,0xec,0x9f,0x0b,0x86,0x3b,0xf8,0xfd,0x78,0x4b,0x86,
+            0x27,0xd1,0x6c,0x0d,0xb6,0xd2,0xcf,0xc7
+        };
+        sm4_xts_ctx kat;
+        ok = sm4_xts_set_key(&kat, kat_key);
+        for (size_t len : { (size_t)32, sizeof(kat_pt) }) {
+            uint8_t buf[sizeof(kat_pt)];
+            ok = ok && sm4_xts_encrypt(&kat, kat_iv, kat_pt, buf, len) && memcmp(buf, kat_ct, len) == 0;
+            ok = ok && sm4_xts_decrypt(&kat, kat_iv, kat_ct, buf, len) && memcmp(buf, kat_pt, len) == 0;
+        }
+        cout << "XTS known-answer vectors: " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // 多线程：与串行结果逐字节一致（长度跨越多个256KB分块且不是16的倍数）
+    {
+        size_t len = 3 * 1024 * 1024 + 777;
+        vector<uint8_t> big(len), a(len), b(len);
+        for (auto& x : big) x = static_cast<uint8_t>(gen());
+        unsigned saved = sm4_threads();
+        sm4_set_threads(4);
+        uint8_t c1[16] = { 0 }, c2[16] = { 0 };
+        c1[15] = c2[15] = 0xf0;
+        sm4_ctr_crypt(&ctx, c1, 32, big.data(), a.data(), len);
+        sm4_ctr_crypt_mt(&ctx, c2, 32, big.data(), b.data(), len);
+        ok = a == b && memcmp(c1, c2, 16) == 0;
+        size_t blocks_big = len / 16;
+        sm4_ecb_encrypt(&ctx, big.data(), a.data(), blocks_big);
+        sm4_ecb_encrypt_mt(&ctx, big.data(), b.data(), blocks_big);
+        ok = ok && a == b;
+        sm4_ecb_decrypt_mt(&ctx, b.data(), b.data(), blocks_big);
+        ok = ok && memcmp(b.data(), big.data(), 16 * blocks_big) == 0;
+        size_t sectors = len / 4096;
+        sm4_xts_encrypt_sectors(&xts, 77, 4096, big.data(), a.data(), sectors);
+        sm4_xts_encrypt_sectors_mt(&xts, 77, 4096, big.data(), b.data(), sectors);
+        ok = ok && memcmp(a.data(), b.data(), 4096 * sectors) == 0;
+        sm4_xts_decrypt_sectors_mt(&xts, 77, 4096, b.data(), b.data(), sectors);
+        ok = ok && memcmp(b.data(), big.data(), 4096 * sectors) == 0;
+        sm4_set_threads(saved);
+        cout << "Multi-threaded ECB/CTR/XTS: " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // 批量密钥扩展：每个内核下都应与逐个sm4_set_key一致；LRU缓存命中时返回相同的上下文
+    {
+        const size_t nkeys = 37;
+        vector<uint8_t> keys(16 * nkeys);
+        for (auto& x : keys) x = static_cast<uint8_t>(gen());
+        vector<sm4_ctx> a(nkeys), b(nkeys);
+        for (size_t i = 0; i < nkeys; i++) sm4_set_key(&a[i], &keys[16 * i]);
+        string saved = sm4_impl_name();
+        ok = true;
+        for (const char* name : { "gfni", "aesni-avx2", "aesni", "ttable" }) {
+            if (!sm4_set_impl(name)) continue;
+            sm4_set_key_batch(b.data(), keys.data(), nkeys);
+            ok = ok && memcmp(a.data(), b.data(), nkeys * sizeof(sm4_ctx)) == 0;
+        }
+        sm4_set_impl(saved.c_str());
+
+        sm4_key_cache cache(16);
+        sm4_ctx c;
+        cache.get_batch(keys.data(), 20, b.data());         // 20个未命中，容量16，淘汰最早的4个
+        ok = ok && memcmp(a.data(), b.data(), 20 * sizeof(sm4_ctx)) == 0 && cache.size() == 16;
+        cache.get(&keys[16 * 19], &c);                       // 命中
+        ok = ok && memcmp(&c, &a[19], sizeof(sm4_ctx)) == 0 && cache.hits() == 1;
+        cache.get(&keys[0], &c);                             // 已被淘汰，重新扩展
+        ok = ok && memcmp(&c, &a[0], sizeof(sm4_ctx)) == 0 && cache.misses() == 21;
+        cout << "Batch key expansion / key cache: " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // DRBG：确定性实例化后与参考实现逐字节一致（含跨64KB请求边界的长度，会被切成多次请求）；
+    // 多线程取nonce不重复
+    {
+        uint8_t seed[32];
+        for (auto& x : seed) x = static_cast<uint8_t>(gen());
+        sm4_drbg drbg;
+        drbg.instantiate(seed);
+        drbg_reference ref(seed);
+        ok = true;
+        for (size_t len : { (size_t)1, (size_t)16, (size_t)37, (size_t)4096, (size_t)100000 }) {
+            vector<uint8_t> a(len), b(len);
+            drbg.generate(a.data(), len);
+            for (size_t off = 0; off < len; off += sm4_drbg::MAX_REQUEST) {
+                ref.generate(b.data() + off, min(len - off, sm4_drbg::MAX_REQUEST));
+            }
+            ok = ok && a == b;
+        }
+
+        sm4_gcm_nonce nonce;
+        vector<vector<uint64_t>> seen(4);
+        vector<thread> workers;
+        for (auto& v : seen) {
+            workers.emplace_back([&nonce, &v] {
+                uint8_t iv[12];
+                for (int i = 0; i < 100000; i++) {
+                    nonce.next(iv);
+                    uint64_t c = 0;
+                    for (int j = 4; j < 12; j++) c = c << 8 | iv[j];
+                    v.push_back(c);
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+        set<uint64_t> all;
+        for (auto& v : seen) all.insert(v.begin(), v.end());
+        ok = ok && all.size() == 400000;
+        sm4_gcm_nonce last(7);
+        uint8_t iv[12];
+        ok = ok && last.next(iv) && iv[3] == 7 && iv[11] == 0;
+        cout << "DRBG / GCM nonce: " << (ok ? "correct" : "MISMATCH") << endl;
+        if (!ok) return 1;
+    }
+
+    // 生成12字节IV的耗时：每字节调用一次random_device（原实现）、线程局部DRBG、确定性nonce
+    {
+        random_device rd;
+        uint8_t iv[12];
+        sm4_gcm_nonce nonce;
+        auto ns = [](double mcalls) { return 1e3 / (mcalls * 1.048576); };
+        cout << "\nIV generation (ns per 12-byte IV)" << endl;
+        cout << left << setw(18) << "random_device" << fixed << setprecision(1)
+            << ns(measure(1000, [&] {
+                for (int i = 0; i < 1000; i++)
+                    for (auto& b : iv) b = static_cast<uint8_t>(rd());
+            })) << endl;
+        cout << left << setw(18) << "sm4_random_bytes" << fixed << setprecision(1)
+            << ns(measure(1000, [&] { for (int i = 0; i < 1000; i++) sm4_random_bytes(iv, 12); })) << endl;
+        cout << left << setw(18) << "sm4_gcm_nonce" << fixed << setprecision(1)
+            << ns(measure(1000, [&] { for (int i = 0; i < 1000; i++) nonce.next(iv); })) << endl;
+        vector<uint8_t> bulk(1024 * 1024);
+        cout << left << setw(18) << "bulk fill" << fixed << setprecision(1)
+            << measure(bulk.size(), [&] { sm4_random_bytes(bulk.data(), bulk.size()); }) << " MB/s" << endl;
+    }
+
+    // 密钥设置：逐个扩展与批量扩展，单位为每秒处理的密钥数
+    {
+        const size_t nkeys = 1024;
+        vector<uint8_t> keys(16 * nkeys);
+        for (auto& x : keys) x = static_cast<uint8_t>(gen());
+        vector<sm4_ctx> out(nkeys);
+        cout << "\nKey setup (" << sm4_impl_name() << ")" << endl;
+        cout << left << setw(18) << "sm4_set_key" << fixed << setprecision(2)
+            << measure(nkeys, [&] {
+                for (size_t i = 0; i < nkeys; i++) sm4_set_key(&out[i], &keys[16 * i]);
+            }) << " M keys/s" << endl;
+        cout << left << setw(18) << "sm4_set_key_batch" << fixed << setprecision(2)
+            << measure(nkeys, [&] { sm4_set_key_batch(out.data(), keys.data(), nkeys); })
+            << " M keys/s" << endl;
+    }
+
+    // 性能：16KB（缓存内）与16MB（超出缓存）
+    for (size_t size : { (size_t)16 * 1024, (size_t)16 * 1024 * 1024 }) {
+        vector<uint8_t> in(size), out(size);
+        for (auto& b : in) b = static_cast<uint8_t>(gen());
+        cout << "\nBuffer size: " << size / 1024 << " KB" << endl;
+        for (const kernel& k : kernels) {
+            if (!k.available) continue;
+            cout << left << setw(18) << k.name << fixed << setprecision(1)
+                << measure(size, [&] { k.fn(in.data(), out.data(), size / 16, rk); }) << " MB/s" << endl;
+        }
+        cout << left << setw(18) << "CBC encrypt" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_cbc_encrypt(&ctx, iv, in.data(), out.data(), size / 16); }) << " MB/s" << endl;
+        cout << left << setw(18) << "CBC decrypt" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_cbc_decrypt(&ctx, iv, in.data(), out.data(), size / 16); }) << " MB/s" << endl;
+        cout << left << setw(18) << "CTR" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_ctr_crypt(&ctx, iv, 32, in.data(), out.data(), size); }) << " MB/s" << endl;
+        cout << left << setw(18) << "XTS 512B sectors" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_xts_encrypt_sectors(&xts, 1000, 512, in.data(), out.data(), size / 512); })
+            << " MB/s" << endl;
+        cout << left << setw(18) << "XTS 4KB sectors" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_xts_encrypt_sectors(&xts, 1000, 4096, in.data(), out.data(), size / 4096); })
+            << " MB/s" << endl;
+        cout << left << setw(18) << "CTR (mt)" << fixed << setprecision(1)
+            << measure(size, [&] { sm4_ctr_crypt_mt(&ctx, iv, 32, in.data(), out.data(), size); })
+            << " MB/s, " << sm4_threads() << " threads" << endl;
+    }
+
+    // T表布局：缓存内连续加密16KB，以及每次先读64KB其他数据挤出L1后只加密256字节
+    // （模拟SM4与其他热点代码交替运行时的情况）
+    {
+        layout layouts[] = {
+            { "sbox", sm4_encrypt_blocks_with<sm4_layout::sbox>, sm4_table_bytes<sm4_layout::sbox>() },
+            { "t8x1", sm4_encrypt_blocks_with<sm4_layout::t8x1>, sm4_table_bytes<sm4_layout::t8x1>() },
+            { "t8x4", sm4_encrypt_blocks_with<sm4_layout::t8x4>, sm4_table_bytes<sm4_layout::t8x4>() },
+            { "t16", sm4_encrypt_blocks_with<sm4_layout::t16>, sm4_table_bytes<sm4_layout::t16>() },
+        };
+        vector<uint8_t> in(16 * 1024), out(in.size()), sweep(64 * 1024);
+        for (auto& b : in) b = static_cast<uint8_t>(gen());
+        volatile uint8_t sink = 0;
+        auto evict = [&] {
+            uint8_t acc = 0;
+            for (size_t i = 0; i < sweep.size(); i += 64) acc ^= sweep[i]++;
+            sink = sink ^ acc;
+        };
+        cout << "\nT-table layouts (cycles/byte)  table      hot 16KB   256B after L1 eviction" << endl;
+        for (const layout& l : layouts) {
+            l.fn(data.data(), ct.data(), data.size() / 16, rk);
+            if (memcmp(ct.data(), ref.data(), data.size()) != 0) {
+                cout << l.name << " MISMATCH" << endl;
+                return 1;
+            }
+            double hot = measure_cycles(in.size(), [] {}, [&] { l.fn(in.data(), out.data(), in.size() / 16, rk); });
+            double cold = measure_cycles(256, evict, [&] { l.fn(in.data(), out.data(), 16, rk); });
+            cout << "  " << left << setw(29) << l.name << setw(11) << (to_string(l.table_bytes / 1024.0).substr(0, 5) + " KB")
+                << fixed << setprecision(2) << setw(11) << hot << cold << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+﻿#include "sm4.h"
+#include "sm4_tables.h"
+
+using namespace std;
+
+// T-table在编译期生成（见sm4_tables.h），启动时不再做任何建表工作
+void init_T_table() {
+}
+
+// 循环左移
+static inline uint32_t rotate_left(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// 非线性变换τ (Tau)
+static inline uint32_t tau(uint32_t x) {
+    return (Sbox[(x >> 24) & 0xFF] << 24) |
+        (Sbox[(x >> 16) & 0xFF] << 16) |
+        (Sbox[(x >> 8) & 0xFF] << 8) |
+        Sbox[x & 0xFF];
+}
+
+// 密钥扩展
+void key_expansion(const uint8_t key[16], uint32_t rk[32]) {
+    uint32_t K[36];
+
+    // 加载初始密钥
+    for (int i = 0; i < 4; i++) {
+        K[i] = ((uint32_t)key[4 * i] << 24) |
+            ((uint32_t)key[4 * i + 1] << 16) |
+            ((uint32_t)key[4 * i + 2] << 8) |
+            key[4 * i + 3];
+        K[i] ^= FK[i];  // 应用FK常量
+    }
+
+    // 生成轮密钥
+    for (int i = 0; i < 32; i++) {
+        uint32_t tmp = K[i + 1] ^ K[i + 2] ^ K[i + 3] ^ CK[i];
+        uint32_t B = tau(tmp);  // 非线性变换
+        rk[i] = K[i] ^ B ^ rotate_left(B, 13) ^ rotate_left(B, 23);
+        K[i + 4] = rk[i];
+    }
+}
+
+// 使用T-table优化的加密函数：每个字节位置一张表（4KB）
+void sm4_encrypt(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]) {
+    sm4_encrypt_with<sm4_layout::t8x4>(in, out, rk);
+}
+
+// 逐分组调用T-table实现，作为多分组接口的标量基准
+void sm4_encrypt_blocks(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    for (size_t i = 0; i < blocks; i++) {
+        sm4_encrypt(in + 16 * i, out + 16 * i, rk);
+    }
+}
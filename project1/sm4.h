@@ -0,0 +1,187 @@
+﻿#pragma once
+// SM4公共接口：密钥扩展、单分组加密以及多分组批量加密
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SM4_X86 1
+#endif
+
+// 为一段代码单独开启指令集（GCC/Clang），MSVC下内建函数无需额外编译开关
+#define SM4_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define SM4_TARGET_BEGIN(isa) SM4_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define SM4_TARGET_END() SM4_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define SM4_TARGET_BEGIN(isa) SM4_PRAGMA(GCC push_options) SM4_PRAGMA(GCC target(isa))
+#define SM4_TARGET_END() SM4_PRAGMA(GCC pop_options)
+#else
+#define SM4_TARGET_BEGIN(isa)
+#define SM4_TARGET_END()
+#endif
+
+// SM4常量定义（constexpr，可用于编译期生成查找表）
+inline constexpr uint8_t Sbox[256] = {
+    0xd6,0x90,0xe9,0xfe,0xcc,0xe1,0x3d,0xb7,0x16,0xb6,0x14,0xc2,0x28,0xfb,0x2c,0x05,
+    0x2b,0x67,0x9a,0x76,0x2a,0xbe,0x04,0xc3,0xaa,0x44,0x13,0x26,0x49,0x86,0x06,0x99,
+    0x9c,0x42,0x50,0xf4,0x91,0xef,0x98,0x7a,0x33,0x54,0x0b,0x43,0xed,0xcf,0xac,0x62,
+    0xe4,0xb3,0x1c,0xa9,0xc9,0x08,0xe8,0x95,0x80,0xdf,0x94,0xfa,0x75,0x8f,0x3f,0xa6,
+    0x47,0x07,0xa7,0xfc,0xf3,0x73,0x17,0xba,0x83,0x59,0x3c,0x19,0xe6,0x85,0x4f,0xa8,
+    0x68,0x6b,0x81,0xb2,0x71,0x64,0xda,0x8b,0xf8,0xeb,0x0f,0x4b,0x70,0x56,0x9d,0x35,
+    0x1e,0x24,0x0e,0x5e,0x63,0x58,0xd1,0xa2,0x25,0x22,0x7c,0x3b,0x01,0x21,0x78,0x87,
+    0xd4,0x00,0x46,0x57,0x9f,0xd3,0x27,0x52,0x4c,0x36,0x02,0xe7,0xa0,0xc4,0xc8,0x9e,
+    0xea,0xbf,0x8a,0xd2,0x40,0xc7,0x38,0xb5,0xa3,0xf7,0xf2,0xce,0xf9,0x61,0x15,0xa1,
+    0xe0,0xae,0x5d,0xa4,0x9b,0x34,0x1a,0x55,0xad,0x93,0x32,0x30,0xf5,0x8c,0xb1,0xe3,
+    0x1d,0xf6,0xe2,0x2e,0x82,0x66,0xca,0x60,0xc0,0x29,0x23,0xab,0x0d,0x53,0x4e,0x6f,
+    0xd5,0xdb,0x37,0x45,0xde,0xfd,0x8e,0x2f,0x03,0xff,0x6a,0x72,0x6d,0x6c,0x5b,0x51,
+    0x8d,0x1b,0xaf,0x92,0xbb,0xdd,0xbc,0x7f,0x11,0xd9,0x5c,0x41,0x1f,0x10,0x5a,0xd8,
+    0x0a,0xc1,0x31,0x88,0xa5,0xcd,0x7b,0xbd,0x2d,0x74,0xd0,0x12,0xb8,0xe5,0xb4,0xb0,
+    0x89,0x69,0x97,0x4a,0x0c,0x96,0x77,0x7e,0x65,0xb9,0xf1,0x09,0xc5,0x6e,0xc6,0x84,
+    0x18,0xf0,0x7d,0xec,0x3a,0xdc,0x4d,0x20,0x79,0xee,0x5f,0x3e,0xd7,0xcb,0x39,0x48
+};
+
+inline constexpr uint32_t FK[4] = {
+    0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc
+};
+
+inline constexpr uint32_t CK[32] = {
+    0x00070e15,0x1c232a31,0x383f464d,0x545b6269,
+    0x70777e85,0x8c939aa1,0xa8afb6bd,0xc4cbd2d9,
+    0xe0e7eef5,0xfc030a11,0x181f262d,0x343b4249,
+    0x50575e65,0x6c737a81,0x888f969d,0xa4abb2b9,
+    0xc0c7ced5,0xdce3eaf1,0xf8ff060d,0x141b2229,
+    0x30373e45,0x4c535a61,0x686f767d,0x848b9299,
+    0xa0a7aeb5,0xbcc3cad1,0xd8dfe6ed,0xf4fb0209,
+    0x10171e25,0x2c333a41,0x484f565d,0x646b7279
+};
+
+// CPU特性检测（cpuid + xgetbv），只在第一次调用时检测
+struct sm4_cpu_features {
+    bool aesni;     // AES-NI + SSSE3
+    bool avx2;
+    bool avx512;    // AVX-512F + AVX-512BW
+    bool gfni;
+    bool pclmul;    // PCLMULQDQ + SSSE3
+    bool vpclmul;   // VPCLMULQDQ（与avx512同时具备时可用512位无进位乘法）
+};
+const sm4_cpu_features& sm4_cpu();
+
+// T表已在编译期生成（sm4_tables.h），此函数为兼容旧代码保留，不做任何事
+void init_T_table();
+
+// 密钥扩展
+void key_expansion(const uint8_t key[16], uint32_t rk[32]);
+
+// 使用T-table优化的单分组加密
+void sm4_encrypt(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]);
+
+// 多分组接口：in/out为连续的blocks个16字节分组，允许原地加密
+typedef void (*sm4_blocks_fn)(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+void sm4_encrypt_blocks(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+
+// 比特切片实现：64位通用寄存器一次处理64个分组，AVX2一次处理256个分组
+// S盒以布尔电路计算，整个加密过程没有任何与数据相关的查表
+void sm4_encrypt_bitslice(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+void sm4_encrypt_bitslice_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+
+// AES-NI实现：SM4 S盒与AES S盒仿射等价，用AESENCLAST一次计算16个S盒
+// sm4_encrypt_aesni每次并行4个分组（需要AES-NI）；sm4_encrypt_aesni_avx2每个ymm并行8个分组，
+// 两组交错共16个分组（还需要AVX2）
+void sm4_encrypt_aesni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+void sm4_encrypt_aesni_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+
+// GFNI + AVX-512实现：VGF2P8AFFINEINVQB直接计算S盒，VPROLD完成循环移位，每次并行16个分组
+// 调用前需确认sm4_cpu().gfni && sm4_cpu().avx512
+void sm4_encrypt_gfni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]);
+
+// 批量密钥扩展：keys为n个连续的16字节密钥，rk依次写入n组32个轮密钥
+// 多个密钥分别占据向量寄存器的各个通道（AVX2每次8个，AVX-512每次16个）
+typedef void (*sm4_keys_fn)(const uint8_t* keys, uint32_t* rk, size_t n);
+void sm4_expand_keys_aesni_avx2(const uint8_t* keys, uint32_t* rk, size_t n);
+void sm4_expand_keys_gfni(const uint8_t* keys, uint32_t* rk, size_t n);
+
+// ---------------------------------------------------------------------------
+// 统一的SM4上下文接口：首次使用时按cpuid选择最快的可用内核
+// 设置环境变量SM4_IMPL=gfni|aesni-avx2|aesni|bitslice-avx2|bitslice|ttable可强制指定
+struct sm4_ctx {
+    uint32_t rk_enc[32];    // 加密轮密钥
+    uint32_t rk_dec[32];    // 解密轮密钥（rk_enc逆序）
+};
+
+void sm4_set_key(sm4_ctx* ctx, const uint8_t key[16]);
+
+// 一次设置n个上下文，keys为n个连续的16字节密钥，使用当前内核对应的SIMD批量密钥扩展
+void sm4_set_key_batch(sm4_ctx* ctx, const uint8_t* keys, size_t n);
+
+// ECB批量加解密，允许原地操作
+void sm4_ecb_encrypt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks);
+void sm4_ecb_decrypt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks);
+
+// 用当前选中的内核处理任意轮密钥（rk_enc或rk_dec），供各工作模式使用
+void sm4_crypt_blocks(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t blocks);
+
+// 当前内核的名字；sm4_set_impl在运行时切换内核，CPU不支持时返回false
+const char* sm4_impl_name();
+bool sm4_set_impl(const char* name);
+
+// 单分组加解密，经由sm4_crypt_blocks使用当前选中的内核
+void sm4_encrypt_block(const sm4_ctx* ctx, const uint8_t in[16], uint8_t out[16]);
+void sm4_decrypt_block(const sm4_ctx* ctx, const uint8_t in[16], uint8_t out[16]);
+
+// CBC模式（不做填充，blocks为分组数），结束后iv更新为最后一个密文分组，便于分段调用
+// 解密各分组互不依赖，按批送入多分组内核并行处理；允许原地操作
+void sm4_cbc_encrypt(const sm4_ctx* ctx, uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t blocks);
+void sm4_cbc_decrypt(const sm4_ctx* ctx, uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t blocks);
+
+// CTR模式：counter为16字节计数器分组（大端序），低ctr_bits位（32、64或128）作为计数器递增，
+// 其余部分保持不变。计数器按批构造后送入多分组内核，加密与解密是同一操作，允许原地操作。
+// len可以不是16的倍数；结束后counter更新为下一个未使用的计数器，
+// 分段调用时除最后一段外len应为16的倍数。ctr_bits不是32、64、128时返回false，不写out、不修改counter
+bool sm4_ctr_crypt(const sm4_ctx* ctx, uint8_t counter[16], int ctr_bits,
+    const uint8_t* in, uint8_t* out, size_t len);
+
+// 计数器分组的低ctr_bits位加n（按相同规则回绕）；ctr_bits无效时返回false
+bool sm4_ctr_add(uint8_t counter[16], int ctr_bits, uint64_t n);
+
+// ---------------------------------------------------------------------------
+// 多线程批量接口：输入按256KB切分，由常驻线程池并行处理（调用线程也参与），
+// 输出与对应的串行接口逐字节一致；数据不足两块或只有一个线程时直接走串行路径。
+// 多个线程可以同时调用（包括sm4_gcm_*_mt），各次调用作为独立的任务组共用线程池，互不串行化
+void sm4_set_threads(unsigned n);   // 总线程数，0表示使用CPU核数（默认）
+unsigned sm4_threads();
+
+void sm4_ecb_encrypt_mt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks);
+void sm4_ecb_decrypt_mt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks);
+bool sm4_ctr_crypt_mt(const sm4_ctx* ctx, uint8_t counter[16], int ctr_bits,
+    const uint8_t* in, uint8_t* out, size_t len);
+
+// ---------------------------------------------------------------------------
+// XTS模式（IEEE 1619的tweak约定），用于磁盘扇区加密：key为32字节，前16字节为数据密钥，
+// 后16字节为tweak密钥（两者必须不同）。tweak按小端序128位整数在GF(2^128)上逐分组乘α。
+// GB/T 17964-2021默认的tweak更新按另一种比特顺序乘α，从第二个分组起结果不同，这里不支持
+// 两半密钥相同时sm4_xts_set_key返回false，不修改ctx
+struct sm4_xts_ctx {
+    sm4_ctx data;
+    sm4_ctx tweak;
+};
+
+bool sm4_xts_set_key(sm4_xts_ctx* ctx, const uint8_t key[32]);
+
+// 加解密一个数据单元：iv为16字节的数据单元号（tweak加密前的值），len >= 16，
+// len不是16的倍数时对最后两个分组做密文窃取；允许原地操作。len < 16时返回false，不写out
+bool sm4_xts_encrypt(const sm4_xts_ctx* ctx, const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len);
+bool sm4_xts_decrypt(const sm4_xts_ctx* ctx, const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len);
+
+// 批量扇区接口：从扇区号sector开始的连续sectors个扇区，每个扇区sector_size字节，
+// 扇区号按小端序作为该扇区的iv。一批扇区的初始tweak一起送入多分组内核计算，
+// 各扇区的tweak链并行推进，数据分组整批加密。sector_size < 16时返回false
+bool sm4_xts_encrypt_sectors(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors);
+bool sm4_xts_decrypt_sectors(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors);
+
+// 多线程扇区接口：扇区按约256KB一组由线程池并行处理，结果与串行接口一致
+bool sm4_xts_encrypt_sectors_mt(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors);
+bool sm4_xts_decrypt_sectors_mt(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors);
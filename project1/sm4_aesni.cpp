@@ -0,0 +1,351 @@
+﻿#include "sm4.h"
+#include <cstring>
+
+#if defined(SM4_X86)
+#include <immintrin.h>
+
+using namespace std;
+
+// 清除内存中的密钥材料，volatile防止被编译器优化掉
+static void wipe(void* p, size_t n) {
+    volatile uint8_t* v = static_cast<volatile uint8_t*>(p);
+    while (n--) *v++ = 0;
+}
+
+// SM4 S盒与AES S盒仿射等价：S_sm4(x) = A2·S_aes(A1·x + c1) + c2
+// 两个仿射变换拆成高低半字节查表，用PSHUFB一次完成16字节；
+// AESENCLAST(x, 0) = ShiftRows(SubBytes(x))，事先做一次逆ShiftRows把字节位置抵消掉
+alignas(16) static const uint8_t pre_lo[16] = {
+    0x3E, 0xB2, 0x0E, 0x82, 0xBB, 0x37, 0x8B, 0x07, 0xA1, 0x2D, 0x91, 0x1D, 0x24, 0xA8, 0x14, 0x98
+};
+alignas(16) static const uint8_t pre_hi[16] = {
+    0x00, 0xDC, 0x2E, 0xF2, 0xC5, 0x19, 0xEB, 0x37, 0x08, 0xD4, 0x26, 0xFA, 0xCD, 0x11, 0xE3, 0x3F
+};
+alignas(16) static const uint8_t post_lo[16] = {
+    0x6C, 0xD4, 0xA6, 0x1E, 0x52, 0xEA, 0x98, 0x20, 0x0B, 0xB3, 0xC1, 0x79, 0x35, 0x8D, 0xFF, 0x47
+};
+alignas(16) static const uint8_t post_hi[16] = {
+    0x00, 0xE0, 0x50, 0xB0, 0x9D, 0x7D, 0xCD, 0x2D, 0xC0, 0x20, 0x90, 0x70, 0x5D, 0xBD, 0x0D, 0xED
+};
+alignas(16) static const uint8_t inv_shift_rows[16] = {
+    0x00, 0x0D, 0x0A, 0x07, 0x04, 0x01, 0x0E, 0x0B, 0x08, 0x05, 0x02, 0x0F, 0x0C, 0x09, 0x06, 0x03
+};
+// 32位字内的字节翻转（SM4按大端序加载）以及按字节循环左移8/16/24位
+alignas(16) static const uint8_t bswap32[16] = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+alignas(16) static const uint8_t rol8[16] = {
+    3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14
+};
+alignas(16) static const uint8_t rol16[16] = {
+    2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13
+};
+alignas(16) static const uint8_t rol24[16] = {
+    1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12
+};
+
+SM4_TARGET_BEGIN("aes,ssse3")
+
+// 4分组版本：每个__m128i保存4个分组的同一个字
+struct sm4_consts_128 {
+    __m128i pre_lo, pre_hi, post_lo, post_hi, isr, bswap, r8, r16, r24, nibble;
+};
+
+static inline sm4_consts_128 load_consts_128() {
+    sm4_consts_128 c;
+    c.pre_lo = _mm_load_si128((const __m128i*)pre_lo);
+    c.pre_hi = _mm_load_si128((const __m128i*)pre_hi);
+    c.post_lo = _mm_load_si128((const __m128i*)post_lo);
+    c.post_hi = _mm_load_si128((const __m128i*)post_hi);
+    c.isr = _mm_load_si128((const __m128i*)inv_shift_rows);
+    c.bswap = _mm_load_si128((const __m128i*)bswap32);
+    c.r8 = _mm_load_si128((const __m128i*)rol8);
+    c.r16 = _mm_load_si128((const __m128i*)rol16);
+    c.r24 = _mm_load_si128((const __m128i*)rol24);
+    c.nibble = _mm_set1_epi8(0x0F);
+    return c;
+}
+
+static inline __m128i affine_128(__m128i x, __m128i lo, __m128i hi, __m128i nibble) {
+    __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, nibble));
+    __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi32(x, 4), nibble));
+    return _mm_xor_si128(l, h);
+}
+
+// 轮函数T = L(τ(x))
+static inline __m128i sm4_t_128(__m128i x, const sm4_consts_128& c) {
+    x = affine_128(x, c.pre_lo, c.pre_hi, c.nibble);
+    x = _mm_shuffle_epi8(x, c.isr);
+    x = _mm_aesenclast_si128(x, _mm_setzero_si128());
+    x = affine_128(x, c.post_lo, c.post_hi, c.nibble);
+
+    // L(x) = x ^ (x <<< 24) ^ ((x ^ (x <<< 8) ^ (x <<< 16)) <<< 2)
+    __m128i y = _mm_xor_si128(x, _mm_shuffle_epi8(x, c.r8));
+    y = _mm_xor_si128(y, _mm_shuffle_epi8(x, c.r16));
+    y = _mm_or_si128(_mm_slli_epi32(y, 2), _mm_srli_epi32(y, 30));
+    return _mm_xor_si128(_mm_xor_si128(x, y), _mm_shuffle_epi8(x, c.r24));
+}
+
+// 4x4的32位矩阵转置：4个分组 <-> 4个字向量
+static inline void transpose_128(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+    __m128i t0 = _mm_unpacklo_epi32(a, b);
+    __m128i t1 = _mm_unpacklo_epi32(c, d);
+    __m128i t2 = _mm_unpackhi_epi32(a, b);
+    __m128i t3 = _mm_unpackhi_epi32(c, d);
+    a = _mm_unpacklo_epi64(t0, t1);
+    b = _mm_unpackhi_epi64(t0, t1);
+    c = _mm_unpacklo_epi64(t2, t3);
+    d = _mm_unpackhi_epi64(t2, t3);
+}
+
+static void sm4_aesni_x4(const uint8_t* in, uint8_t* out, const uint32_t rk[32], const sm4_consts_128& c) {
+    __m128i x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 0)), c.bswap);
+    __m128i x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)), c.bswap);
+    __m128i x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)), c.bswap);
+    __m128i x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)), c.bswap);
+    transpose_128(x0, x1, x2, x3);
+
+    // 循环展开4轮，省去寄存器轮换
+    for (int i = 0; i < 32; i += 4) {
+        x0 = _mm_xor_si128(x0, sm4_t_128(_mm_xor_si128(_mm_xor_si128(x1, x2), _mm_xor_si128(x3, _mm_set1_epi32((int)rk[i]))), c));
+        x1 = _mm_xor_si128(x1, sm4_t_128(_mm_xor_si128(_mm_xor_si128(x2, x3), _mm_xor_si128(x0, _mm_set1_epi32((int)rk[i + 1]))), c));
+        x2 = _mm_xor_si128(x2, sm4_t_128(_mm_xor_si128(_mm_xor_si128(x3, x0), _mm_xor_si128(x1, _mm_set1_epi32((int)rk[i + 2]))), c));
+        x3 = _mm_xor_si128(x3, sm4_t_128(_mm_xor_si128(_mm_xor_si128(x0, x1), _mm_xor_si128(x2, _mm_set1_epi32((int)rk[i + 3]))), c));
+    }
+
+    // 反序变换R：输出(X35, X34, X33, X32)
+    transpose_128(x3, x2, x1, x0);
+    _mm_storeu_si128((__m128i*)(out + 0), _mm_shuffle_epi8(x3, c.bswap));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_shuffle_epi8(x2, c.bswap));
+    _mm_storeu_si128((__m128i*)(out + 32), _mm_shuffle_epi8(x1, c.bswap));
+    _mm_storeu_si128((__m128i*)(out + 48), _mm_shuffle_epi8(x0, c.bswap));
+}
+
+void sm4_encrypt_aesni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    const sm4_consts_128 c = load_consts_128();
+    for (; blocks >= 4; blocks -= 4, in += 64, out += 64) {
+        sm4_aesni_x4(in, out, rk, c);
+    }
+    // 不足4个分组时补零凑满一批
+    if (blocks) {
+        uint8_t buf[64] = { 0 };
+        memcpy(buf, in, 16 * blocks);
+        sm4_aesni_x4(buf, buf, rk, c);
+        memcpy(out, buf, 16 * blocks);
+        wipe(buf, sizeof(buf));
+    }
+}
+
+SM4_TARGET_END()
+
+SM4_TARGET_BEGIN("aes,avx2")
+
+// 8分组版本：ymm的低/高128位分别保存分组0-3和4-7的同一个字
+// AVX2没有256位的AESENCLAST，拆成两半各执行一次
+struct sm4_consts_256 {
+    __m256i pre_lo, pre_hi, post_lo, post_hi, isr, bswap, r8, r16, r24, nibble;
+};
+
+static inline __m256i broadcast_256(const uint8_t* p) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)p));
+}
+
+static inline sm4_consts_256 load_consts_256() {
+    sm4_consts_256 c;
+    c.pre_lo = broadcast_256(pre_lo);
+    c.pre_hi = broadcast_256(pre_hi);
+    c.post_lo = broadcast_256(post_lo);
+    c.post_hi = broadcast_256(post_hi);
+    c.isr = broadcast_256(inv_shift_rows);
+    c.bswap = broadcast_256(bswap32);
+    c.r8 = broadcast_256(rol8);
+    c.r16 = broadcast_256(rol16);
+    c.r24 = broadcast_256(rol24);
+    c.nibble = _mm256_set1_epi8(0x0F);
+    return c;
+}
+
+static inline __m256i affine_256(__m256i x, __m256i lo, __m256i hi, __m256i nibble) {
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, nibble));
+    __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi32(x, 4), nibble));
+    return _mm256_xor_si256(l, h);
+}
+
+// 非线性变换τ：32个字节同时过S盒
+static inline __m256i sbox_256(__m256i x, const sm4_consts_256& c) {
+    x = affine_256(x, c.pre_lo, c.pre_hi, c.nibble);
+    x = _mm256_shuffle_epi8(x, c.isr);
+    __m128i lo = _mm_aesenclast_si128(_mm256_castsi256_si128(x), _mm_setzero_si128());
+    __m128i hi = _mm_aesenclast_si128(_mm256_extracti128_si256(x, 1), _mm_setzero_si128());
+    x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    return affine_256(x, c.post_lo, c.post_hi, c.nibble);
+}
+
+static inline __m256i sm4_t_256(__m256i x, const sm4_consts_256& c) {
+    x = sbox_256(x, c);
+
+    __m256i y = _mm256_xor_si256(x, _mm256_shuffle_epi8(x, c.r8));
+    y = _mm256_xor_si256(y, _mm256_shuffle_epi8(x, c.r16));
+    y = _mm256_or_si256(_mm256_slli_epi32(y, 2), _mm256_srli_epi32(y, 30));
+    return _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_shuffle_epi8(x, c.r24));
+}
+
+static inline void transpose_256(__m256i& a, __m256i& b, __m256i& c, __m256i& d) {
+    __m256i t0 = _mm256_unpacklo_epi32(a, b);
+    __m256i t1 = _mm256_unpacklo_epi32(c, d);
+    __m256i t2 = _mm256_unpackhi_epi32(a, b);
+    __m256i t3 = _mm256_unpackhi_epi32(c, d);
+    a = _mm256_unpacklo_epi64(t0, t1);
+    b = _mm256_unpackhi_epi64(t0, t1);
+    c = _mm256_unpacklo_epi64(t2, t3);
+    d = _mm256_unpackhi_epi64(t2, t3);
+}
+
+// 低128位取第k个分组，高128位取第k+4个分组
+static inline __m256i load_pair(const uint8_t* in, int k, __m256i bswap) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)(in + 16 * k));
+    __m128i hi = _mm_loadu_si128((const __m128i*)(in + 16 * (k + 4)));
+    return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), bswap);
+}
+
+static inline void store_pair(uint8_t* out, int k, __m256i v, __m256i bswap) {
+    v = _mm256_shuffle_epi8(v, bswap);
+    _mm_storeu_si128((__m128i*)(out + 16 * k), _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i*)(out + 16 * (k + 4)), _mm256_extracti128_si256(v, 1));
+}
+
+static void sm4_aesni_x8(const uint8_t* in, uint8_t* out, const uint32_t rk[32], const sm4_consts_256& c) {
+    __m256i x0 = load_pair(in, 0, c.bswap);
+    __m256i x1 = load_pair(in, 1, c.bswap);
+    __m256i x2 = load_pair(in, 2, c.bswap);
+    __m256i x3 = load_pair(in, 3, c.bswap);
+    transpose_256(x0, x1, x2, x3);
+
+    for (int i = 0; i < 32; i += 4) {
+        x0 = _mm256_xor_si256(x0, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, _mm256_set1_epi32((int)rk[i]))), c));
+        x1 = _mm256_xor_si256(x1, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x2, x3), _mm256_xor_si256(x0, _mm256_set1_epi32((int)rk[i + 1]))), c));
+        x2 = _mm256_xor_si256(x2, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x3, x0), _mm256_xor_si256(x1, _mm256_set1_epi32((int)rk[i + 2]))), c));
+        x3 = _mm256_xor_si256(x3, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x0, x1), _mm256_xor_si256(x2, _mm256_set1_epi32((int)rk[i + 3]))), c));
+    }
+
+    transpose_256(x3, x2, x1, x0);
+    store_pair(out, 0, x3, c.bswap);
+    store_pair(out, 1, x2, c.bswap);
+    store_pair(out, 2, x1, c.bswap);
+    store_pair(out, 3, x0, c.bswap);
+}
+
+// 两组8分组交错执行，掩盖AESENCLAST和PSHUFB的延迟
+static void sm4_aesni_x16(const uint8_t* in, uint8_t* out, const uint32_t rk[32], const sm4_consts_256& c) {
+    __m256i x0 = load_pair(in, 0, c.bswap);
+    __m256i x1 = load_pair(in, 1, c.bswap);
+    __m256i x2 = load_pair(in, 2, c.bswap);
+    __m256i x3 = load_pair(in, 3, c.bswap);
+    __m256i y0 = load_pair(in + 128, 0, c.bswap);
+    __m256i y1 = load_pair(in + 128, 1, c.bswap);
+    __m256i y2 = load_pair(in + 128, 2, c.bswap);
+    __m256i y3 = load_pair(in + 128, 3, c.bswap);
+    transpose_256(x0, x1, x2, x3);
+    transpose_256(y0, y1, y2, y3);
+
+    for (int i = 0; i < 32; i += 4) {
+        __m256i k = _mm256_set1_epi32((int)rk[i]);
+        x0 = _mm256_xor_si256(x0, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, k)), c));
+        y0 = _mm256_xor_si256(y0, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(y1, y2), _mm256_xor_si256(y3, k)), c));
+        k = _mm256_set1_epi32((int)rk[i + 1]);
+        x1 = _mm256_xor_si256(x1, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x2, x3), _mm256_xor_si256(x0, k)), c));
+        y1 = _mm256_xor_si256(y1, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(y2, y3), _mm256_xor_si256(y0, k)), c));
+        k = _mm256_set1_epi32((int)rk[i + 2]);
+        x2 = _mm256_xor_si256(x2, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x3, x0), _mm256_xor_si256(x1, k)), c));
+        y2 = _mm256_xor_si256(y2, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(y3, y0), _mm256_xor_si256(y1, k)), c));
+        k = _mm256_set1_epi32((int)rk[i + 3]);
+        x3 = _mm256_xor_si256(x3, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(x0, x1), _mm256_xor_si256(x2, k)), c));
+        y3 = _mm256_xor_si256(y3, sm4_t_256(_mm256_xor_si256(_mm256_xor_si256(y0, y1), _mm256_xor_si256(y2, k)), c));
+    }
+
+    transpose_256(x3, x2, x1, x0);
+    transpose_256(y3, y2, y1, y0);
+    store_pair(out, 0, x3, c.bswap);
+    store_pair(out, 1, x2, c.bswap);
+    store_pair(out, 2, x1, c.bswap);
+    store_pair(out, 3, x0, c.bswap);
+    store_pair(out + 128, 0, y3, c.bswap);
+    store_pair(out + 128, 1, y2, c.bswap);
+    store_pair(out + 128, 2, y1, c.bswap);
+    store_pair(out + 128, 3, y0, c.bswap);
+}
+
+void sm4_encrypt_aesni_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    const sm4_consts_256 c = load_consts_256();
+    for (; blocks >= 16; blocks -= 16, in += 256, out += 256) {
+        sm4_aesni_x16(in, out, rk, c);
+    }
+    for (; blocks >= 8; blocks -= 8, in += 128, out += 128) {
+        sm4_aesni_x8(in, out, rk, c);
+    }
+    // 剩余不足8个分组交给4分组版本
+    if (blocks) {
+        sm4_encrypt_aesni(in, out, blocks, rk);
+    }
+}
+
+// 批量密钥扩展：8个密钥各占ymm的一个32位通道，CK[i]充当轮密钥，
+// 线性变换换成L'(B) = B ^ (B <<< 13) ^ (B <<< 23)，每轮的新字即为轮密钥
+static void expand_keys_x8(const uint8_t* keys, uint32_t* rk, size_t n, const sm4_consts_256& c) {
+    uint8_t buf[128] = { 0 };
+    memcpy(buf, keys, 16 * n);
+    __m256i x0 = load_pair(buf, 0, c.bswap);
+    __m256i x1 = load_pair(buf, 1, c.bswap);
+    __m256i x2 = load_pair(buf, 2, c.bswap);
+    __m256i x3 = load_pair(buf, 3, c.bswap);
+    transpose_256(x0, x1, x2, x3);
+    x0 = _mm256_xor_si256(x0, _mm256_set1_epi32((int)FK[0]));
+    x1 = _mm256_xor_si256(x1, _mm256_set1_epi32((int)FK[1]));
+    x2 = _mm256_xor_si256(x2, _mm256_set1_epi32((int)FK[2]));
+    x3 = _mm256_xor_si256(x3, _mm256_set1_epi32((int)FK[3]));
+
+    // 转置后第d个32位通道正好对应第d个密钥
+    alignas(32) uint32_t v[8];
+    for (int i = 0; i < 32; i++) {
+        __m256i t = _mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, _mm256_set1_epi32((int)CK[i])));
+        t = sbox_256(t, c);
+        __m256i r13 = _mm256_or_si256(_mm256_slli_epi32(t, 13), _mm256_srli_epi32(t, 19));
+        __m256i r23 = _mm256_or_si256(_mm256_slli_epi32(t, 23), _mm256_srli_epi32(t, 9));
+        __m256i k = _mm256_xor_si256(x0, _mm256_xor_si256(t, _mm256_xor_si256(r13, r23)));
+        _mm256_store_si256((__m256i*)v, k);
+        for (size_t j = 0; j < n; j++) rk[32 * j + i] = v[j];
+        x0 = x1; x1 = x2; x2 = x3; x3 = k;
+    }
+    wipe(buf, sizeof(buf));
+    wipe(v, sizeof(v));
+}
+
+void sm4_expand_keys_aesni_avx2(const uint8_t* keys, uint32_t* rk, size_t n) {
+    const sm4_consts_256 c = load_consts_256();
+    while (n > 0) {
+        size_t m = n < 8 ? n : 8;
+        expand_keys_x8(keys, rk, m, c);
+        keys += 16 * m;
+        rk += 32 * m;
+        n -= m;
+    }
+}
+
+SM4_TARGET_END()
+
+#else
+
+// 非x86平台退回T-table实现
+void sm4_encrypt_aesni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    sm4_encrypt_blocks(in, out, blocks, rk);
+}
+
+void sm4_encrypt_aesni_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    sm4_encrypt_blocks(in, out, blocks, rk);
+}
+
+void sm4_expand_keys_aesni_avx2(const uint8_t* keys, uint32_t* rk, size_t n) {
+    for (size_t j = 0; j < n; j++) key_expansion(keys + 16 * j, rk + 32 * j);
+}
+
+#endif
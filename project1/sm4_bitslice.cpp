@@ -0,0 +1,22 @@
+﻿#include "sm4.h"
+
+using namespace std;
+
+// 64位通用寄存器版本：每个切片是一个uint64_t，一批处理64个分组
+typedef uint64_t bs_word;
+#define BS_LANES 1
+
+static inline bs_word bs_xor(bs_word a, bs_word b) { return a ^ b; }
+static inline bs_word bs_and(bs_word a, bs_word b) { return a & b; }
+static inline bs_word bs_not(bs_word a) { return ~a; }
+static inline bs_word bs_shl(bs_word a, int n) { return a << n; }
+static inline bs_word bs_shr(bs_word a, int n) { return a >> n; }
+static inline bs_word bs_set1(uint64_t v) { return v; }
+static inline bs_word bs_load(const uint64_t* v) { return v[0]; }
+static inline void bs_store(uint64_t* v, bs_word a) { v[0] = a; }
+
+#include "sm4_bitslice_impl.h"
+
+void sm4_encrypt_bitslice(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    bs_encrypt_blocks(in, out, blocks, rk);
+}
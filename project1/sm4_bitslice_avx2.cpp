@@ -0,0 +1,38 @@
+﻿#include "sm4.h"
+
+#if defined(SM4_X86)
+#include <immintrin.h>
+
+using namespace std;
+
+SM4_TARGET_BEGIN("avx2")
+
+// AVX2版本：每个切片是一个__m256i（4个64位通道），一批处理256个分组
+typedef __m256i bs_word;
+#define BS_LANES 4
+
+static inline bs_word bs_xor(bs_word a, bs_word b) { return _mm256_xor_si256(a, b); }
+static inline bs_word bs_and(bs_word a, bs_word b) { return _mm256_and_si256(a, b); }
+static inline bs_word bs_not(bs_word a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+static inline bs_word bs_shl(bs_word a, int n) { return _mm256_slli_epi64(a, n); }
+static inline bs_word bs_shr(bs_word a, int n) { return _mm256_srli_epi64(a, n); }
+static inline bs_word bs_set1(uint64_t v) { return _mm256_set1_epi64x((long long)v); }
+static inline bs_word bs_load(const uint64_t* v) { return _mm256_loadu_si256((const __m256i*)v); }
+static inline void bs_store(uint64_t* v, bs_word a) { _mm256_storeu_si256((__m256i*)v, a); }
+
+#include "sm4_bitslice_impl.h"
+
+void sm4_encrypt_bitslice_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    bs_encrypt_blocks(in, out, blocks, rk);
+}
+
+SM4_TARGET_END()
+
+#else
+
+// 非x86平台没有AVX2，退回64位比特切片
+void sm4_encrypt_bitslice_avx2(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    sm4_encrypt_bitslice(in, out, blocks, rk);
+}
+
+#endif
@@ -0,0 +1,340 @@
+﻿// 比特切片SM4的通用实现，由sm4_bitslice.cpp和sm4_bitslice_avx2.cpp分别包含
+// 包含前需要定义：
+//   bs_word                 一个切片寄存器（uint64_t或__m256i）
+//   BS_LANES                bs_word中64位通道的个数
+//   bs_xor/bs_and/bs_not    逐位运算
+//   bs_shl/bs_shr           每个64位通道内的移位
+//   bs_set1                 把64位常量广播到所有通道
+//   bs_load/bs_store        与BS_LANES个uint64_t之间的转换
+// 本文件只定义static函数，不同指令集的两份实例互不影响
+
+#define BS_BLOCKS (64 * BS_LANES)   // 每批处理的分组数
+
+// 64x64比特矩阵转置：执行后a[j]的第i位等于原a[i]的第j位（每个64位通道独立转置）
+static inline void bs_transpose64(bs_word a[64]) {
+    static const uint64_t masks[6] = {
+        0x00000000FFFFFFFFULL, 0x0000FFFF0000FFFFULL, 0x00FF00FF00FF00FFULL,
+        0x0F0F0F0F0F0F0F0FULL, 0x3333333333333333ULL, 0x5555555555555555ULL
+    };
+    int level = 0;
+    for (int s = 32; s > 0; s >>= 1, level++) {
+        bs_word m = bs_set1(masks[level]);
+        for (int k = 0; k < 64; k++) {
+            if (k & s) continue;
+            bs_word t = bs_and(bs_xor(bs_shr(a[k], s), a[k + s]), m);
+            a[k + s] = bs_xor(a[k + s], t);
+            a[k] = bs_xor(a[k], bs_shl(t, s));
+        }
+    }
+}
+
+// SM4 S盒的布尔电路：x[i]/y[i]为字节的第i位（i=0为最低位）
+// 构造方法：S(x) = A·I(A·x + 0xD3) + 0xD3，其中I为GF(2^8)上的求逆，
+// 把求逆映射到塔域GF(((2^2)^2)^2)上计算，得到36个与门、148个异或门和25个非门
+static inline void bs_sbox(const bs_word x[8], bs_word y[8]) {
+    bs_word t0 = bs_not(x[6]);
+    bs_word t1 = bs_xor(x[4], x[6]);
+    bs_word t2 = bs_xor(x[3], t1);
+    bs_word t3 = bs_xor(x[1], t2);
+    bs_word t4 = bs_and(t0, t3);
+    bs_word t5 = bs_xor(x[1], x[2]);
+    bs_word t6 = bs_xor(x[0], t5);
+    bs_word t7 = bs_xor(t1, t6);
+    bs_word t8 = bs_xor(x[5], x[7]);
+    bs_word t9 = bs_xor(x[4], t8);
+    bs_word t10 = bs_xor(x[2], t9);
+    bs_word t11 = bs_xor(x[0], t10);
+    bs_word t12 = bs_and(t7, t11);
+    bs_word t13 = bs_xor(x[4], t6);
+    bs_word t14 = bs_not(t13);
+    bs_word t15 = bs_xor(x[3], x[6]);
+    bs_word t16 = bs_xor(t8, t15);
+    bs_word t17 = bs_xor(t6, t16);
+    bs_word t18 = bs_and(t14, t17);
+    bs_word t19 = bs_xor(x[3], x[5]);
+    bs_word t20 = bs_xor(t7, t19);
+    bs_word t21 = bs_not(t20);
+    bs_word t22 = bs_xor(t6, t15);
+    bs_word t23 = bs_not(t22);
+    bs_word t24 = bs_and(t21, t23);
+    bs_word t25 = bs_xor(x[2], x[7]);
+    bs_word t26 = bs_not(t25);
+    bs_word t27 = bs_xor(x[0], x[1]);
+    bs_word t28 = bs_xor(t9, t27);
+    bs_word t29 = bs_not(t28);
+    bs_word t30 = bs_and(t26, t29);
+    bs_word t31 = bs_xor(t15, t28);
+    bs_word t32 = bs_xor(t10, t15);
+    bs_word t33 = bs_and(t31, t32);
+    bs_word t34 = bs_xor(t13, t19);
+    bs_word t35 = bs_xor(x[2], x[4]);
+    bs_word t36 = bs_xor(x[0], t35);
+    bs_word t37 = bs_not(t36);
+    bs_word t38 = bs_and(t34, t37);
+    bs_word t39 = bs_xor(x[7], t27);
+    bs_word t40 = bs_xor(t1, t39);
+    bs_word t41 = bs_not(t40);
+    bs_word t42 = bs_not(t5);
+    bs_word t43 = bs_and(t41, t42);
+    bs_word t44 = bs_xor(x[2], t16);
+    bs_word t45 = bs_not(t44);
+    bs_word t46 = bs_xor(x[4], t27);
+    bs_word t47 = bs_and(t45, t46);
+    bs_word t48 = bs_xor(t43, t47);
+    bs_word t49 = bs_xor(t18, t48);
+    bs_word t50 = bs_xor(t12, t49);
+    bs_word t51 = bs_xor(x[5], t50);
+    bs_word t52 = bs_xor(t6, t51);
+    bs_word t53 = bs_not(t52);
+    bs_word t54 = bs_xor(t24, t33);
+    bs_word t55 = bs_xor(t18, t54);
+    bs_word t56 = bs_xor(t12, t55);
+    bs_word t57 = bs_xor(x[1], t56);
+    bs_word t58 = bs_xor(t32, t57);
+    bs_word t59 = bs_and(t53, t58);
+    bs_word t60 = bs_xor(t38, t43);
+    bs_word t61 = bs_xor(t12, t60);
+    bs_word t62 = bs_xor(t4, t61);
+    bs_word t63 = bs_xor(t1, t62);
+    bs_word t64 = bs_xor(t30, t33);
+    bs_word t65 = bs_xor(t12, t64);
+    bs_word t66 = bs_xor(t4, t65);
+    bs_word t67 = bs_xor(t8, t66);
+    bs_word t68 = bs_xor(t7, t67);
+    bs_word t69 = bs_not(t68);
+    bs_word t70 = bs_and(t63, t69);
+    bs_word t71 = bs_xor(t38, t47);
+    bs_word t72 = bs_xor(t18, t71);
+    bs_word t73 = bs_xor(t4, t72);
+    bs_word t74 = bs_xor(x[5], t73);
+    bs_word t75 = bs_xor(t7, t74);
+    bs_word t76 = bs_not(t75);
+    bs_word t77 = bs_xor(t24, t30);
+    bs_word t78 = bs_xor(t18, t77);
+    bs_word t79 = bs_xor(t4, t78);
+    bs_word t80 = bs_xor(x[3], t79);
+    bs_word t81 = bs_xor(x[0], t80);
+    bs_word t82 = bs_not(t81);
+    bs_word t83 = bs_and(t76, t82);
+    bs_word t84 = bs_xor(t70, t83);
+    bs_word t85 = bs_xor(t4, t84);
+    bs_word t86 = bs_xor(x[3], t85);
+    bs_word t87 = bs_xor(t60, t86);
+    bs_word t88 = bs_xor(t8, t87);
+    bs_word t89 = bs_xor(t5, t88);
+    bs_word t90 = bs_xor(t55, t89);
+    bs_word t91 = bs_and(t53, t90);
+    bs_word t92 = bs_xor(t59, t83);
+    bs_word t93 = bs_xor(x[7], t92);
+    bs_word t94 = bs_xor(t72, t93);
+    bs_word t95 = bs_xor(t65, t94);
+    bs_word t96 = bs_and(t63, t95);
+    bs_word t97 = bs_xor(t59, t70);
+    bs_word t98 = bs_xor(t12, t97);
+    bs_word t99 = bs_xor(t4, t98);
+    bs_word t100 = bs_xor(t77, t99);
+    bs_word t101 = bs_xor(t48, t100);
+    bs_word t102 = bs_xor(t19, t101);
+    bs_word t103 = bs_xor(t5, t102);
+    bs_word t104 = bs_and(t76, t103);
+    bs_word t105 = bs_xor(x[0], x[7]);
+    bs_word t106 = bs_xor(t54, t105);
+    bs_word t107 = bs_xor(t48, t106);
+    bs_word t108 = bs_xor(t2, t107);
+    bs_word t109 = bs_not(t108);
+    bs_word t110 = bs_and(t109, t90);
+    bs_word t111 = bs_xor(t60, t64);
+    bs_word t112 = bs_xor(t8, t111);
+    bs_word t113 = bs_xor(t6, t112);
+    bs_word t114 = bs_not(t113);
+    bs_word t115 = bs_and(t114, t95);
+    bs_word t116 = bs_xor(x[2], x[5]);
+    bs_word t117 = bs_xor(t77, t116);
+    bs_word t118 = bs_xor(t71, t117);
+    bs_word t119 = bs_xor(t3, t118);
+    bs_word t120 = bs_and(t119, t103);
+    bs_word t121 = bs_xor(t115, t120);
+    bs_word t122 = bs_and(t0, t121);
+    bs_word t123 = bs_xor(t110, t115);
+    bs_word t124 = bs_and(t7, t123);
+    bs_word t125 = bs_xor(t110, t120);
+    bs_word t126 = bs_and(t14, t125);
+    bs_word t127 = bs_xor(t96, t104);
+    bs_word t128 = bs_and(t21, t127);
+    bs_word t129 = bs_xor(t91, t96);
+    bs_word t130 = bs_and(t26, t129);
+    bs_word t131 = bs_xor(t91, t104);
+    bs_word t132 = bs_and(t31, t131);
+    bs_word t133 = bs_xor(t121, t127);
+    bs_word t134 = bs_and(t34, t133);
+    bs_word t135 = bs_xor(t123, t129);
+    bs_word t136 = bs_and(t41, t135);
+    bs_word t137 = bs_xor(t125, t131);
+    bs_word t138 = bs_and(t45, t137);
+    bs_word t139 = bs_xor(x[3], x[4]);
+    bs_word t140 = bs_xor(x[1], t139);
+    bs_word t141 = bs_not(t140);
+    bs_word t142 = bs_and(t141, t121);
+    bs_word t143 = bs_xor(x[1], x[6]);
+    bs_word t144 = bs_xor(t8, t143);
+    bs_word t145 = bs_and(t144, t123);
+    bs_word t146 = bs_xor(x[4], t16);
+    bs_word t147 = bs_not(t146);
+    bs_word t148 = bs_and(t147, t125);
+    bs_word t149 = bs_xor(x[4], x[5]);
+    bs_word t150 = bs_and(t149, t127);
+    bs_word t151 = bs_xor(x[5], t13);
+    bs_word t152 = bs_and(t151, t129);
+    bs_word t153 = bs_and(t6, t131);
+    bs_word t154 = bs_xor(x[1], t19);
+    bs_word t155 = bs_not(t154);
+    bs_word t156 = bs_and(t155, t133);
+    bs_word t157 = bs_xor(x[6], x[7]);
+    bs_word t158 = bs_xor(t36, t157);
+    bs_word t159 = bs_and(t158, t135);
+    bs_word t160 = bs_xor(x[2], t31);
+    bs_word t161 = bs_not(t160);
+    bs_word t162 = bs_and(t161, t137);
+    bs_word t163 = bs_xor(t156, t159);
+    bs_word t164 = bs_xor(t153, t163);
+    bs_word t165 = bs_xor(t152, t164);
+    bs_word t166 = bs_xor(t132, t165);
+    bs_word t167 = bs_xor(t130, t166);
+    bs_word t168 = bs_xor(t124, t167);
+    bs_word t169 = bs_xor(t122, t168);
+    bs_word t170 = bs_not(t169);
+    bs_word t171 = bs_xor(t152, t153);
+    bs_word t172 = bs_xor(t145, t171);
+    bs_word t173 = bs_xor(t142, t172);
+    bs_word t174 = bs_xor(t130, t173);
+    bs_word t175 = bs_xor(t128, t174);
+    bs_word t176 = bs_xor(t126, t175);
+    bs_word t177 = bs_xor(t122, t176);
+    bs_word t178 = bs_not(t177);
+    bs_word t179 = bs_xor(t148, t150);
+    bs_word t180 = bs_xor(t142, t179);
+    bs_word t181 = bs_xor(t138, t180);
+    bs_word t182 = bs_xor(t134, t181);
+    bs_word t183 = bs_xor(t132, t182);
+    bs_word t184 = bs_xor(t130, t183);
+    bs_word t185 = bs_xor(t126, t184);
+    bs_word t186 = bs_xor(t124, t185);
+    bs_word t187 = bs_xor(t164, t186);
+    bs_word t188 = bs_xor(t136, t138);
+    bs_word t189 = bs_xor(t132, t188);
+    bs_word t190 = bs_xor(t128, t189);
+    bs_word t191 = bs_xor(t173, t190);
+    bs_word t192 = bs_xor(t159, t162);
+    bs_word t193 = bs_xor(t153, t192);
+    bs_word t194 = bs_xor(t150, t193);
+    bs_word t195 = bs_not(t194);
+    bs_word t196 = bs_xor(t190, t194);
+    bs_word t197 = bs_xor(t128, t152);
+    bs_word t198 = bs_xor(t124, t197);
+    bs_word t199 = bs_xor(t122, t198);
+    bs_word t200 = bs_xor(t183, t199);
+    bs_word t201 = bs_not(t200);
+    bs_word t202 = bs_xor(t156, t162);
+    bs_word t203 = bs_xor(t150, t202);
+    bs_word t204 = bs_xor(t138, t203);
+    bs_word t205 = bs_xor(t134, t204);
+    bs_word t206 = bs_xor(t132, t205);
+    bs_word t207 = bs_xor(t199, t206);
+    bs_word t208 = bs_not(t207);
+    y[0] = t170;
+    y[1] = t178;
+    y[2] = t187;
+    y[3] = t191;
+    y[4] = t195;
+    y[5] = t196;
+    y[6] = t201;
+    y[7] = t208;
+}
+
+// 把BS_BLOCKS个分组中一对32位字(w, w+1)装入64个切片
+// 转置后s[32 + j]是字w的第j位，s[j]是字w+1的第j位
+static inline void bs_load_words(const uint8_t* in, size_t blocks, int w, bs_word s[64]) {
+    uint64_t row[BS_LANES];
+    for (int i = 0; i < 64; i++) {
+        for (int g = 0; g < BS_LANES; g++) {
+            size_t b = (size_t)g * 64 + i;
+            uint64_t v = 0;
+            if (b < blocks) {
+                const uint8_t* p = in + 16 * b + 4 * w;
+                for (int k = 0; k < 8; k++) v = (v << 8) | p[k];
+            }
+            row[g] = v;
+        }
+        s[i] = bs_load(row);
+    }
+    bs_transpose64(s);
+}
+
+static inline void bs_store_words(uint8_t* out, size_t blocks, int w, bs_word s[64]) {
+    uint64_t row[BS_LANES];
+    bs_transpose64(s);
+    for (int i = 0; i < 64; i++) {
+        bs_store(row, s[i]);
+        for (int g = 0; g < BS_LANES; g++) {
+            size_t b = (size_t)g * 64 + i;
+            if (b >= blocks) continue;
+            uint8_t* p = out + 16 * b + 4 * w;
+            for (int k = 0; k < 8; k++) p[k] = (uint8_t)(row[g] >> (56 - 8 * k));
+        }
+    }
+}
+
+// 加密一批（不超过BS_BLOCKS个）分组，不足的部分按全零分组参与运算后丢弃
+static void bs_encrypt_batch(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    bs_word X[4][32];
+    bs_word pair[64];
+
+    bs_load_words(in, blocks, 0, pair);
+    for (int j = 0; j < 32; j++) { X[0][j] = pair[32 + j]; X[1][j] = pair[j]; }
+    bs_load_words(in, blocks, 2, pair);
+    for (int j = 0; j < 32; j++) { X[2][j] = pair[32 + j]; X[3][j] = pair[j]; }
+
+    // 第r轮时X[r%4]..X[(r+3)%4]依次为X_r..X_{r+3}，新字覆盖X[r%4]
+    for (int round = 0; round < 32; round++) {
+        bs_word* x0 = X[round & 3];
+        const bs_word* x1 = X[(round + 1) & 3];
+        const bs_word* x2 = X[(round + 2) & 3];
+        const bs_word* x3 = X[(round + 3) & 3];
+        bs_word t[32], s[32];
+
+        // 轮密钥的每一位广播成全0或全1
+        for (int j = 0; j < 32; j++) {
+            bs_word k = bs_set1(0 - (uint64_t)((rk[round] >> j) & 1));
+            t[j] = bs_xor(bs_xor(x1[j], x2[j]), bs_xor(x3[j], k));
+        }
+
+        // 非线性变换τ：四个字节各过一次S盒电路
+        for (int b = 0; b < 32; b += 8) {
+            bs_sbox(t + b, s + b);
+        }
+
+        // 线性变换L：循环移位在切片表示下只是下标变换
+        for (int j = 0; j < 32; j++) {
+            bs_word l = bs_xor(s[j], s[(j - 2) & 31]);
+            l = bs_xor(l, bs_xor(s[(j - 10) & 31], s[(j - 18) & 31]));
+            l = bs_xor(l, s[(j - 24) & 31]);
+            x0[j] = bs_xor(x0[j], l);
+        }
+    }
+
+    // 反序变换：输出(X35, X34, X33, X32)
+    for (int j = 0; j < 32; j++) { pair[32 + j] = X[3][j]; pair[j] = X[2][j]; }
+    bs_store_words(out, blocks, 0, pair);
+    for (int j = 0; j < 32; j++) { pair[32 + j] = X[1][j]; pair[j] = X[0][j]; }
+    bs_store_words(out, blocks, 2, pair);
+}
+
+static void bs_encrypt_blocks(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    while (blocks > 0) {
+        size_t n = blocks < BS_BLOCKS ? blocks : BS_BLOCKS;
+        bs_encrypt_batch(in, out, n, rk);
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+}
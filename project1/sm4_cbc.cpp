@@ -0,0 +1,69 @@
+﻿#include "sm4.h"
+#include "../probe/probe.h"
+#include <cstring>
+
+using namespace std;
+
+// 每批解密的分组数：4KB，正好留在L1中，也是各多分组内核批量大小的整数倍
+static const size_t CBC_BATCH = 256;
+
+static inline void xor_block(uint8_t* out, const uint8_t* a, const uint8_t* b) {
+    uint64_t x[2], y[2];
+    memcpy(x, a, 16);
+    memcpy(y, b, 16);
+    x[0] ^= y[0];
+    x[1] ^= y[1];
+    memcpy(out, x, 16);
+}
+
+// 单分组同样交给选中的内核，GCM的H与E(J0)、DRBG等处的密钥相关运算不经过T-table
+void sm4_encrypt_block(const sm4_ctx* ctx, const uint8_t in[16], uint8_t out[16]) {
+    sm4_crypt_blocks(ctx->rk_enc, in, out, 1);
+}
+
+void sm4_decrypt_block(const sm4_ctx* ctx, const uint8_t in[16], uint8_t out[16]) {
+    sm4_crypt_blocks(ctx->rk_dec, in, out, 1);
+}
+
+// CBC加密前后分组串行相关，只能逐个分组处理；每个分组也交给选中的内核
+void sm4_cbc_encrypt(const sm4_ctx* ctx, uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t blocks) {
+    PROBE(PROBE_CBC, 16 * blocks, blocks);
+    uint8_t prev_block[16];
+    memcpy(prev_block, iv, 16);
+
+    for (size_t i = 0; i < blocks; i++) {
+        uint8_t block[16];
+        xor_block(block, in + 16 * i, prev_block);
+        sm4_crypt_blocks(ctx->rk_enc, block, out + 16 * i, 1);
+        memcpy(prev_block, out + 16 * i, 16);
+    }
+    memcpy(iv, prev_block, 16);
+}
+
+// CBC解密：P_i = D(C_i) ^ C_{i-1}，各分组的D(C_i)互不依赖
+// 先把一批密文整体送入多分组内核，再与前一个密文分组异或
+void sm4_cbc_decrypt(const sm4_ctx* ctx, uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t blocks) {
+    PROBE(PROBE_CBC, 16 * blocks, blocks);
+    uint8_t buf[16 * CBC_BATCH];
+    uint8_t prev_block[16];
+    memcpy(prev_block, iv, 16);
+
+    while (blocks > 0) {
+        size_t n = blocks < CBC_BATCH ? blocks : CBC_BATCH;
+        sm4_crypt_blocks(ctx->rk_dec, in, buf, n);
+
+        // 原地解密时in会被覆盖，先保存本批最后一个密文分组
+        uint8_t last[16];
+        memcpy(last, in + 16 * (n - 1), 16);
+        for (size_t i = n - 1; i > 0; i--) {
+            xor_block(out + 16 * i, buf + 16 * i, in + 16 * (i - 1));
+        }
+        xor_block(out, buf, prev_block);
+        memcpy(prev_block, last, 16);
+
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+    memcpy(iv, prev_block, 16);
+}
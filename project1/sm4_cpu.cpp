@@ -0,0 +1,66 @@
+﻿#include "sm4.h"
+
+#if defined(SM4_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace std;
+
+#if defined(SM4_X86)
+static void cpuid(uint32_t leaf, uint32_t sub, uint32_t r[4]) {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, (int)leaf, (int)sub);
+    for (int i = 0; i < 4; i++) r[i] = (uint32_t)regs[i];
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// 读取XCR0，确认操作系统会保存对应的向量寄存器
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+static sm4_cpu_features detect() {
+    sm4_cpu_features f = {};
+#if defined(SM4_X86)
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+
+    cpuid(1, 0, r);
+    f.aesni = ((r[2] >> 25) & 1) && ((r[2] >> 9) & 1);
+    f.pclmul = ((r[2] >> 1) & 1) && ((r[2] >> 9) & 1);
+    bool osxsave = (r[2] >> 27) & 1;
+    bool avx = (r[2] >> 28) & 1;
+    uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    bool ymm_os = (xcr0 & 0x6) == 0x6;      // XMM + YMM
+    bool zmm_os = (xcr0 & 0xE6) == 0xE6;    // 另加opmask + ZMM
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, r);
+        f.avx2 = avx && ymm_os && ((r[1] >> 5) & 1);
+        f.avx512 = zmm_os && ((r[1] >> 16) & 1) && ((r[1] >> 30) & 1);
+        f.gfni = (r[2] >> 8) & 1;
+        f.vpclmul = (r[2] >> 10) & 1;
+    }
+#endif
+    return f;
+}
+
+const sm4_cpu_features& sm4_cpu() {
+    static const sm4_cpu_features features = detect();
+    return features;
+}
@@ -0,0 +1,113 @@
+﻿#include "sm4.h"
+#include <cstring>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+using namespace std;
+
+// 每批生成的计数器分组数（4KB）
+static const size_t CTR_BATCH = 256;
+
+static inline uint64_t bswap64(uint64_t v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return bswap64(v);
+}
+
+static inline void store_be64(uint8_t* p, uint64_t v) {
+    v = bswap64(v);
+    memcpy(p, &v, 8);
+}
+
+// 计数器分组按大端序拆成hi/lo两个64位整数，只有低ctr_bits位参与递增
+struct ctr_state {
+    uint64_t hi, lo;
+    int bits;
+};
+
+// 只支持32、64、128位计数器：0位时所有分组共用同一个计数器（密钥流重复），
+// 其他宽度在ctr_add中会使移位越界
+static inline bool ctr_bits_valid(int bits) {
+    return bits == 32 || bits == 64 || bits == 128;
+}
+
+// 计算第n个后继计数器
+static inline void ctr_add(const ctr_state& c, uint64_t n, uint64_t& hi, uint64_t& lo) {
+    if (c.bits == 128) {
+        lo = c.lo + n;
+        hi = c.hi + (lo < c.lo ? 1 : 0);
+    }
+    else if (c.bits == 64) {
+        hi = c.hi;
+        lo = c.lo + n;
+    }
+    else {
+        uint64_t mask = (1ULL << c.bits) - 1;
+        hi = c.hi;
+        lo = (c.lo & ~mask) | ((c.lo + n) & mask);
+    }
+}
+
+bool sm4_ctr_crypt(const sm4_ctx* ctx, uint8_t counter[16], int ctr_bits,
+    const uint8_t* in, uint8_t* out, size_t len) {
+    if (!ctr_bits_valid(ctr_bits)) return false;
+    ctr_state c = { load_be64(counter), load_be64(counter + 8), ctr_bits };
+    uint8_t ctrs[16 * CTR_BATCH];
+    uint8_t ks[16 * CTR_BATCH];
+    size_t blocks = (len + 15) / 16;
+    uint64_t done = 0;
+
+    while (blocks > 0) {
+        size_t n = blocks < CTR_BATCH ? blocks : CTR_BATCH;
+
+        // 批量构造计数器分组，再一次性送入多分组内核生成密钥流
+        for (size_t i = 0; i < n; i++) {
+            uint64_t hi, lo;
+            ctr_add(c, done + i, hi, lo);
+            store_be64(ctrs + 16 * i, hi);
+            store_be64(ctrs + 16 * i + 8, lo);
+        }
+        sm4_crypt_blocks(ctx->rk_enc, ctrs, ks, n);
+
+        // 按64位字异或，最后一个不完整分组逐字节处理
+        size_t bytes = len < 16 * n ? len : 16 * n;
+        size_t words = bytes / 8;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t a, b;
+            memcpy(&a, in + 8 * i, 8);
+            memcpy(&b, ks + 8 * i, 8);
+            a ^= b;
+            memcpy(out + 8 * i, &a, 8);
+        }
+        for (size_t i = 8 * words; i < bytes; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+
+        in += bytes;
+        out += bytes;
+        len -= bytes;
+        blocks -= n;
+        done += n;
+    }
+
+    return sm4_ctr_add(counter, ctr_bits, done);
+}
+
+bool sm4_ctr_add(uint8_t counter[16], int ctr_bits, uint64_t n) {
+    if (!ctr_bits_valid(ctr_bits)) return false;
+    ctr_state c = { load_be64(counter), load_be64(counter + 8), ctr_bits };
+    uint64_t hi, lo;
+    ctr_add(c, n, hi, lo);
+    store_be64(counter, hi);
+    store_be64(counter + 8, lo);
+    return true;
+}
@@ -0,0 +1,123 @@
+﻿#include "sm4.h"
+#include "../probe/probe.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// 可供选择的多分组内核，按优先级从高到低排列。各内核自己处理任意分组数（比特切片内核
+// 不足一批时补零分组参与运算），尾部不再交给T-table，短消息同样没有与数据相关的查表。
+// bitslice（64位）与ttable吞吐量相当，为了恒定时间排在ttable之前
+// expand为对应的批量密钥扩展，为空时逐个调用key_expansion
+struct sm4_kernel {
+    const char* name;
+    sm4_blocks_fn fn;
+    bool (*available)();
+    sm4_keys_fn expand;
+};
+
+static bool always() { return true; }
+static bool has_gfni() { return sm4_cpu().gfni && sm4_cpu().avx512; }
+static bool has_aesni_avx2() { return sm4_cpu().aesni && sm4_cpu().avx2; }
+static bool has_aesni() { return sm4_cpu().aesni; }
+static bool has_avx2() { return sm4_cpu().avx2; }
+
+static const sm4_kernel kernels[] = {
+    { "gfni", sm4_encrypt_gfni, has_gfni, sm4_expand_keys_gfni },
+    { "aesni-avx2", sm4_encrypt_aesni_avx2, has_aesni_avx2, sm4_expand_keys_aesni_avx2 },
+    { "aesni", sm4_encrypt_aesni, has_aesni, nullptr },
+    { "bitslice-avx2", sm4_encrypt_bitslice_avx2, has_avx2, nullptr },
+    { "bitslice", sm4_encrypt_bitslice, always, nullptr },
+    { "ttable", sm4_encrypt_blocks, always, nullptr },
+};
+static const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static const sm4_kernel* find_kernel(const char* name) {
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (strcmp(kernels[i].name, name) == 0) return &kernels[i];
+    }
+    return nullptr;
+}
+
+// 启动时选择：环境变量SM4_IMPL可强制指定内核（用于基准测试），否则选可用的最快内核
+static const sm4_kernel* select_kernel() {
+    const char* env = getenv("SM4_IMPL");
+    if (env && *env && strcmp(env, "auto") != 0) {
+        const sm4_kernel* k = find_kernel(env);
+        if (k && k->available()) return k;
+        fprintf(stderr, "SM4_IMPL=%s is not available on this CPU, using auto selection\n", env);
+    }
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (kernels[i].available()) return &kernels[i];
+    }
+    return &kernels[kernel_count - 1];
+}
+
+// 当前内核。sm4_set_impl可能与其他线程中正在使用内核的调用（例如线程池的工作线程）同时执行，
+// 普通指针的并发读写是数据竞争，所以用原子指针。内核表是只读的静态数据，除指针本身外
+// 没有需要发布给其他线程的内容，读写都用relaxed即可
+static atomic<const sm4_kernel*>& active_slot() {
+    static atomic<const sm4_kernel*> active{ select_kernel() };
+    return active;
+}
+
+static const sm4_kernel* active_kernel() {
+    return active_slot().load(memory_order_relaxed);
+}
+
+const char* sm4_impl_name() {
+    return active_kernel()->name;
+}
+
+bool sm4_set_impl(const char* name) {
+    const sm4_kernel* k = find_kernel(name);
+    if (!k || !k->available()) return false;
+    active_slot().store(k, memory_order_relaxed);
+    return true;
+}
+
+void sm4_set_key(sm4_ctx* ctx, const uint8_t key[16]) {
+    key_expansion(key, ctx->rk_enc);
+    // 解密与加密结构相同，只是轮密钥逆序使用
+    for (int i = 0; i < 32; i++) {
+        ctx->rk_dec[i] = ctx->rk_enc[31 - i];
+    }
+}
+
+void sm4_set_key_batch(sm4_ctx* ctx, const uint8_t* keys, size_t n) {
+    sm4_keys_fn expand = active_kernel()->expand;
+    uint32_t rk[32 * 64];
+    while (n > 0) {
+        size_t m = n < 64 ? n : 64;
+        if (expand) {
+            expand(keys, rk, m);
+        }
+        else {
+            for (size_t j = 0; j < m; j++) key_expansion(keys + 16 * j, rk + 32 * j);
+        }
+        for (size_t j = 0; j < m; j++) {
+            for (int i = 0; i < 32; i++) {
+                ctx[j].rk_enc[i] = rk[32 * j + i];
+                ctx[j].rk_dec[31 - i] = rk[32 * j + i];
+            }
+        }
+        ctx += m;
+        keys += 16 * m;
+        n -= m;
+    }
+}
+
+void sm4_crypt_blocks(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t blocks) {
+    PROBE(PROBE_SM4, 16 * blocks, blocks);
+    if (blocks) active_kernel()->fn(in, out, blocks, rk);
+}
+
+void sm4_ecb_encrypt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks) {
+    sm4_crypt_blocks(ctx->rk_enc, in, out, blocks);
+}
+
+void sm4_ecb_decrypt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks) {
+    sm4_crypt_blocks(ctx->rk_dec, in, out, blocks);
+}
@@ -0,0 +1,184 @@
+﻿#include "sm4_drbg.h"
+#include <cerrno>
+#include <cstring>
+#include <random>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/random.h>
+#endif
+
+using namespace std;
+
+// 清除内存中的密钥材料，volatile防止被编译器优化掉
+static void wipe(void* p, size_t n) {
+    volatile uint8_t* v = static_cast<volatile uint8_t*>(p);
+    while (n--) *v++ = 0;
+}
+
+// 从操作系统取熵：Linux用getrandom（不经过文件描述符，启动早期也可用），
+// 其他平台或getrandom不可用（内核早于3.17）时用random_device
+static void os_entropy(uint8_t* out, size_t len) {
+#if defined(__linux__)
+    while (len > 0) {
+        ssize_t n = getrandom(out, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        out += n;
+        len -= (size_t)n;
+    }
+#endif
+    if (len > 0) {
+        random_device rd;
+        for (size_t i = 0; i < len; i += 4) {
+            uint32_t r = rd();
+            memcpy(out + i, &r, len - i < 4 ? len - i : 4);
+        }
+    }
+}
+
+// 种子材料 = 熵 ^ 附加数据（不足32字节的部分补零）
+static void seed_material(uint8_t seed[32], const uint8_t* data, size_t len) {
+    os_entropy(seed, 32);
+    if (len > 32) len = 32;
+    for (size_t i = 0; i < len; i++) seed[i] ^= data[i];
+}
+
+sm4_drbg::sm4_drbg(const uint8_t* personalization, size_t len) {
+    uint8_t seed[32];
+    seed_material(seed, personalization, len);
+    instantiate(seed);
+    wipe(seed, sizeof(seed));
+}
+
+sm4_drbg::~sm4_drbg() {
+    wipe(&ctx, sizeof(ctx));
+    wipe(V, sizeof(V));
+}
+
+void sm4_drbg::instantiate(const uint8_t seed[32]) {
+    uint8_t zero_key[16] = { 0 };
+    sm4_set_key(&ctx, zero_key);
+    memset(V, 0, sizeof(V));
+    update(seed);
+    reseed_counter = 1;
+}
+
+// CTR_DRBG_Update：K || V = (E(K, V+1) || E(K, V+2)) ^ provided
+void sm4_drbg::update(const uint8_t provided[32]) {
+    uint8_t temp[32];
+    for (int i = 0; i < 2; i++) {
+        sm4_ctr_add(V, 128, 1);
+        sm4_encrypt_block(&ctx, V, temp + 16 * i);
+    }
+    for (int i = 0; i < 32; i++) temp[i] ^= provided[i];
+    sm4_set_key(&ctx, temp);
+    memcpy(V, temp + 16, 16);
+    wipe(temp, sizeof(temp));
+}
+
+void sm4_drbg::reseed(const uint8_t* additional, size_t len) {
+    uint8_t seed[32];
+    seed_material(seed, additional, len);
+    update(seed);
+    wipe(seed, sizeof(seed));
+    reseed_counter = 1;
+}
+
+// 每次请求：输出E(K, V+1), E(K, V+2), ...（走多分组CTR内核），V前进相应的分组数，
+// 再用全零的附加数据更新K和V，已输出的随机数无法由之后的状态反推
+void sm4_drbg::generate(uint8_t* out, size_t len) {
+    static const uint8_t zero[32] = { 0 };
+    while (len > 0) {
+        if (reseed_counter > RESEED_INTERVAL) reseed();
+        size_t n = len < MAX_REQUEST ? len : MAX_REQUEST;
+
+        uint8_t counter[16];
+        memcpy(counter, V, 16);
+        sm4_ctr_add(counter, 128, 1);
+        memset(out, 0, n);
+        sm4_ctr_crypt(&ctx, counter, 128, out, out, n);
+        sm4_ctr_add(V, 128, (n + 15) / 16);
+
+        update(zero);
+        reseed_counter++;
+        out += n;
+        len -= n;
+    }
+}
+
+#if defined(__linux__)
+// fork计数：子进程中加一。getpid()每次都是系统调用，放在取随机数的快速路径上太慢
+static atomic<uint64_t> fork_generation{ 0 };
+
+static uint64_t current_fork_generation() {
+    static const int registered = pthread_atfork(nullptr, nullptr, [] { fork_generation++; });
+    (void)registered;
+    return fork_generation.load(memory_order_relaxed);
+}
+#endif
+
+// 线程局部实例：缓冲一次生成4KB，小请求只是一次拷贝
+namespace {
+struct local_random {
+    sm4_drbg drbg;
+    uint8_t buf[4096];
+    size_t pos = sizeof(buf);
+#if defined(__linux__)
+    uint64_t generation = current_fork_generation();
+#endif
+
+    ~local_random() { wipe(buf, sizeof(buf)); }
+};
+}
+
+void sm4_random_bytes(uint8_t* out, size_t len) {
+    thread_local local_random r;
+#if defined(__linux__)
+    // fork出的子进程继承了父进程的状态，必须重新播种并丢弃缓冲
+    uint64_t generation = current_fork_generation();
+    if (r.generation != generation) {
+        r.generation = generation;
+        r.drbg.reseed();
+        r.pos = sizeof(r.buf);
+    }
+#endif
+    if (len >= sizeof(r.buf)) {
+        r.drbg.generate(out, len);
+        return;
+    }
+    while (len > 0) {
+        if (r.pos == sizeof(r.buf)) {
+            r.drbg.generate(r.buf, sizeof(r.buf));
+            r.pos = 0;
+        }
+        size_t n = sizeof(r.buf) - r.pos < len ? sizeof(r.buf) - r.pos : len;
+        memcpy(out, r.buf + r.pos, n);
+        memset(r.buf + r.pos, 0, n);
+        r.pos += n;
+        out += n;
+        len -= n;
+    }
+}
+
+sm4_gcm_nonce::sm4_gcm_nonce() {
+    uint8_t b[4];
+    sm4_random_bytes(b, 4);
+    fixed = (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3];
+}
+
+sm4_gcm_nonce::sm4_gcm_nonce(uint32_t fixed) : fixed(fixed) {
+}
+
+// 计数器到达最大值后不再前进，之后的调用都返回false
+bool sm4_gcm_nonce::next(uint8_t iv[12]) {
+    uint64_t c = counter.load(memory_order_relaxed);
+    do {
+        if (c == UINT64_MAX) return false;
+    } while (!counter.compare_exchange_weak(c, c + 1, memory_order_relaxed));
+
+    for (int i = 0; i < 4; i++) iv[i] = (uint8_t)(fixed >> (24 - 8 * i));
+    for (int i = 0; i < 8; i++) iv[4 + i] = (uint8_t)(c >> (56 - 8 * i));
+    return true;
+}
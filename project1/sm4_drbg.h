@@ -0,0 +1,55 @@
+﻿#pragma once
+// 基于SM4-CTR的确定性随机比特生成器（按NIST SP 800-90A CTR_DRBG构造，不使用派生函数），
+// 用于生成IV、nonce等；以及保证同一密钥下不重复的GCM nonce生成器
+#include "sm4.h"
+#include <atomic>
+
+class sm4_drbg {
+public:
+    // 从操作系统取32字节熵作为种子；personalization可选，最多32字节，与种子异或
+    explicit sm4_drbg(const uint8_t* personalization = nullptr, size_t len = 0);
+    ~sm4_drbg();
+
+    sm4_drbg(const sm4_drbg&) = delete;
+    sm4_drbg& operator=(const sm4_drbg&) = delete;
+
+    // 生成len字节随机数，内部按64KB一次请求切分，每次请求后更新内部状态；单个实例不可多线程共用
+    void generate(uint8_t* out, size_t len);
+
+    // 从操作系统重新取熵，additional可选（最多32字节）
+    void reseed(const uint8_t* additional = nullptr, size_t len = 0);
+
+    // 用给定的32字节种子材料重新实例化，输出完全确定，供测试使用；之后仍会按周期从操作系统重新播种
+    void instantiate(const uint8_t seed[32]);
+
+    // 每次请求最多输出的字节数，以及两次播种之间最多的请求数
+    static const size_t MAX_REQUEST = 64 * 1024;
+    static const uint64_t RESEED_INTERVAL = 1 << 16;
+
+private:
+    void update(const uint8_t provided[32]);
+
+    sm4_ctx ctx;
+    uint8_t V[16];
+    uint64_t reseed_counter;
+};
+
+// 线程局部的DRBG实例，首次使用时播种；小请求从4KB缓冲中取，用过的字节随即清零。
+// Linux下进程fork后子进程会重新播种，不会与父进程输出相同的序列
+void sm4_random_bytes(uint8_t* out, size_t len);
+
+// GCM的确定性nonce（SP 800-38D 8.2.1）：4字节固定字段 || 8字节调用计数器（均为大端序）。
+// 同一个生成器内计数器只增不减，因此一个密钥只要只用一个生成器，nonce就不会重复；可多线程调用。
+// 密钥更换时应新建生成器
+class sm4_gcm_nonce {
+public:
+    sm4_gcm_nonce();                        // 固定字段取自sm4_random_bytes
+    explicit sm4_gcm_nonce(uint32_t fixed); // 固定字段由调用方分配（如设备号、连接号）
+
+    // 写入下一个12字节nonce；计数器用尽时返回false，此时必须更换密钥
+    bool next(uint8_t iv[12]);
+
+private:
+    uint32_t fixed;
+    std::atomic<uint64_t> counter{ 0 };
+};
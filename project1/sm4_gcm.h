@@ -0,0 +1,134 @@
+﻿#pragma once
+// SM4-GCM：GHASH的多种实现（逐位、PCLMULQDQ、VPCLMULQDQ）与GCM工作模式
+#include "sm4.h"
+#include <vector>
+
+// GF(2^128)元素：high为分组的前8字节、low为后8字节（均按大端序），与project1-b.cpp一致
+struct u128 { uint64_t high, low; };
+
+// GF(2^128)乘法（GCM的比特序），逐位移位异或，作为参考实现
+u128 GF128_mul(const u128& X, const u128& Y);
+
+struct sm4_ghash_kernel;
+
+// GHASH密钥上下文：初始化时按当前选中的实现预计算，之后一直使用该实现
+// 各实现的预计算数据互不同时使用，共用同一块存储
+struct sm4_ghash_key {
+    u128 H;
+    const sm4_ghash_kernel* kernel;
+    union {
+        // 无进位乘法实现使用的H^8, H^7, ..., H^1（各乘以x^-1，按xmm内存布局低64位在前），
+        // 每8个分组只需归约一次
+        alignas(64) uint64_t clmul_pow[8][2];
+        // Shoup查表实现：H与所有4位（256B）或8位（4KB）值的乘积
+        u128 shoup4[16];
+        u128 shoup8[256];
+    };
+};
+
+void sm4_ghash_init(sm4_ghash_key* key, const u128& H);
+
+// Y = (...((Y ^ X_1)·H ^ X_2)·H ...)·H，data为blocks个完整的16字节分组
+void sm4_ghash_update(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+
+// 与project1-b.cpp相同的语义：GHASH_H(data)，data长度不是16的倍数时最后一块补零
+u128 GHASH(const u128& H, const std::vector<uint8_t>& data);
+
+// 当前GHASH实现的名字；sm4_ghash_set_impl在运行时切换（bitwise|shoup4|shoup8|pclmul|vpclmul），
+// CPU不支持时返回false
+// 也可用环境变量SM4_GHASH_IMPL指定
+const char* sm4_ghash_impl_name();
+bool sm4_ghash_set_impl(const char* name);
+
+// 各实现的GHASH分组函数，调用前需确认CPU支持（pclmul：sm4_cpu().pclmul；vpclmul：还需avx512与vpclmul）
+void sm4_ghash_bitwise(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+void sm4_ghash_shoup4(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+void sm4_ghash_shoup8(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+void sm4_ghash_pclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+void sm4_ghash_vpclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+
+// 由key->H计算各实现的预计算数据（sm4_ghash_init_clmul需要pclmul）
+void sm4_ghash_init_shoup4(sm4_ghash_key* key);
+void sm4_ghash_init_shoup8(sm4_ghash_key* key);
+void sm4_ghash_init_clmul(sm4_ghash_key* key);
+
+// ---------------------------------------------------------------------------
+// SP 800-38D的长度上限：正文不超过2^32-2个分组（再多32位计数器就会回绕到J0，
+// 重复使用标签掩码E(J0)和之前的密钥流），附加数据不超过2^64-1比特。超过时各接口返回false
+static const uint64_t SM4_GCM_MAX_TEXT = (1ULL << 36) - 32;
+static const uint64_t SM4_GCM_MAX_AAD = (1ULL << 61) - 1;
+
+// 一次完成的SM4-GCM：IV任意长度，aad为附加数据（可为空），允许原地操作。
+// CTR与GHASH按段交替进行，整个过程只扫描一遍数据，不在堆上分配内存。
+// 解密时标签不符返回false，并把out清零；长度超过上限时返回false，不写out
+bool sm4_gcm_encrypt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]);
+bool sm4_gcm_decrypt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]);
+
+// 多线程GCM：正文按256KB分段，由线程池并行完成各段的CTR与GHASH，再用H^(段内分组数)合并各段的GHASH值，
+// 结果与sm4_gcm_encrypt / sm4_gcm_decrypt逐字节一致；数据不足两段或只有一个线程时直接走串行路径。
+// 长度超过上限时在启动线程前返回false，不写out
+bool sm4_gcm_encrypt_mt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]);
+bool sm4_gcm_decrypt_mt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]);
+
+// 流式SM4-GCM：init之后先用sm4_gcm_aad送入附加数据（可多次），再用sm4_gcm_update处理正文，
+// 每次调用的长度任意，输出立即可用；最后sm4_gcm_final得到标签（加密），
+// 或sm4_gcm_verify校验标签（解密，update输出的明文在校验通过前不可信）。
+// 内存占用与消息长度无关；ctx在整个过程中必须保持有效。
+// 附加数据或正文累计长度超过上限时，该次调用返回false且不处理数据，错误被记录下来，
+// 之后的update都返回false，sm4_gcm_final输出全零标签并返回false，sm4_gcm_verify返回false
+struct sm4_gcm_ctx {
+    const sm4_ctx* cipher;
+    sm4_ghash_key ghash;
+    u128 S;                 // 当前GHASH值
+    uint8_t J0[16];
+    uint8_t ctr[16];        // 下一个未使用的计数器分组
+    // 携带缓冲：附加数据阶段存放未满一组的AAD；正文阶段前buf_len字节为本组已处理的密文，其余为密钥流
+    uint8_t buf[16];
+    size_t buf_len;
+    uint64_t aad_len, text_len;
+    bool in_text;
+    bool decrypt;
+    bool failed;            // 长度超过上限
+};
+
+void sm4_gcm_init(sm4_gcm_ctx* g, const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, bool decrypt);
+bool sm4_gcm_aad(sm4_gcm_ctx* g, const uint8_t* aad, size_t len);     // 已开始处理正文或超过上限时返回false
+bool sm4_gcm_update(sm4_gcm_ctx* g, const uint8_t* in, uint8_t* out, size_t len);
+bool sm4_gcm_final(sm4_gcm_ctx* g, uint8_t tag[16]);
+bool sm4_gcm_verify(sm4_gcm_ctx* g, const uint8_t tag[16]);
+
+// 多记录批处理：适合大量64～1500字节的短记录。H在设置密钥时推导一次；
+// 同一密钥的连续记录把J0与各自的计数器分组合并成一批送入多分组内核，E(J0)与密钥流一起得到，
+// 不做堆分配。超过一批容量（约4KB）的记录单独走流式路径
+struct sm4_gcm_key {
+    sm4_ctx cipher;
+    sm4_ghash_key ghash;
+};
+
+void sm4_gcm_set_key(sm4_gcm_key* key, const uint8_t k[16]);
+
+struct sm4_gcm_record {
+    const sm4_gcm_key* key;
+    const uint8_t* iv;
+    size_t iv_len;
+    const uint8_t* aad;
+    size_t aad_len;
+    const uint8_t* in;
+    uint8_t* out;           // 允许与in相同
+    size_t len;
+    uint8_t tag[16];        // 加密时输出，解密时为待校验的标签
+};
+
+// 两个接口都返回成功的记录数；ok非空时写入每条记录的结果。
+// 加密只有长度超过上限的记录会失败（不写out，标签为全零）；解密时校验失败的记录输出被清零
+size_t sm4_gcm_encrypt_batch(sm4_gcm_record* records, size_t n, bool* ok);
+size_t sm4_gcm_decrypt_batch(sm4_gcm_record* records, size_t n, bool* ok);
+
+// GCM加密，与project1-b.cpp的GCM()接口相同（无附加数据），认证标签写入res
+// IV为12字节时J0 = IV || 0^31 || 1，否则J0 = GHASH(IV || 0填充 || IV的比特长度)
+void GCM(const sm4_ctx* ctx, const std::vector<uint8_t>& IV, const std::vector<uint8_t>& plaintext,
+    std::vector<uint8_t>& ciphertext, uint8_t res[16]);
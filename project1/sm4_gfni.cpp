@@ -0,0 +1,145 @@
+﻿#include "sm4.h"
+
+#if defined(SM4_X86)
+#include "../common/intrin.h"
+
+using namespace std;
+
+// GFNI实现：VGF2P8AFFINEQB / VGF2P8AFFINEINVQB直接计算S盒
+//   S(x) = M2·inv(M1·x + 0x3E) + 0xD3
+// 其中inv为AES所用GF(2^8)（模0x11B）上的求逆，M1、M2已合并SM4的仿射变换与两个域之间的同构
+// 矩阵按VGF2P8AFFINEQB的格式存放：第7-i个字节是输出第i位对应的行
+static const long long SBOX_M1 = 0x4C287DB91A22505DLL;
+static const int SBOX_C1 = 0x3E;
+static const long long SBOX_M2 = (long long)0xF3AB34A974A6B589ULL;
+static const int SBOX_C2 = 0xD3;
+
+SM4_TARGET_BEGIN("avx512f,avx512bw,gfni")
+
+// 16分组版本：每个zmm的第i个128位通道保存分组i、i+4、i+8、i+12的同一个字
+static inline void transpose_512(__m512i& a, __m512i& b, __m512i& c, __m512i& d) {
+    __m512i t0 = _mm512_unpacklo_epi32(a, b);
+    __m512i t1 = _mm512_unpacklo_epi32(c, d);
+    __m512i t2 = _mm512_unpackhi_epi32(a, b);
+    __m512i t3 = _mm512_unpackhi_epi32(c, d);
+    a = _mm512_unpacklo_epi64(t0, t1);
+    b = _mm512_unpackhi_epi64(t0, t1);
+    c = _mm512_unpacklo_epi64(t2, t3);
+    d = _mm512_unpackhi_epi64(t2, t3);
+}
+
+// 轮函数：返回X_i ^ T(X_{i+1} ^ X_{i+2} ^ X_{i+3} ^ rk)
+static inline __m512i sm4_round_512(__m512i x0, __m512i x1, __m512i x2, __m512i x3, __m512i k,
+    __m512i m1, __m512i m2) {
+    __m512i t = _mm512_xor_si512(_mm512_ternarylogic_epi32(x1, x2, x3, 0x96), k);
+    t = _mm512_gf2p8affine_epi64_epi8(t, m1, SBOX_C1);
+    t = _mm512_gf2p8affineinv_epi64_epi8(t, m2, SBOX_C2);
+
+    // L(t) = t ^ (t <<< 2) ^ (t <<< 10) ^ (t <<< 18) ^ (t <<< 24)，VPROLD直接完成循环移位
+    __m512i a = _mm512_ternarylogic_epi32(t, _mm512_rol_epi32(t, 2), _mm512_rol_epi32(t, 10), 0x96);
+    __m512i b = _mm512_ternarylogic_epi32(x0, _mm512_rol_epi32(t, 18), _mm512_rol_epi32(t, 24), 0x96);
+    return _mm512_xor_si512(a, b);
+}
+
+// 加密n（1~16）个分组，不足16个时用掩码读写，不会越界访问
+static void sm4_gfni_x16(const uint8_t* in, uint8_t* out, size_t n, const uint32_t rk[32]) {
+    const __m512i bswap = _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    const __m512i m1 = _mm512_set1_epi64(SBOX_M1);
+    const __m512i m2 = _mm512_set1_epi64(SBOX_M2);
+
+    // 每个zmm对应4个连续分组（16个32位字），按分组个数生成掩码
+    __mmask16 mask[4];
+    for (int k = 0; k < 4; k++) {
+        size_t valid = n > 4 * (size_t)k ? n - 4 * (size_t)k : 0;
+        mask[k] = valid >= 4 ? (__mmask16)0xFFFF : (__mmask16)((1u << (4 * valid)) - 1);
+    }
+
+    __m512i x0 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[0], in), bswap);
+    __m512i x1 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[1], in + 64), bswap);
+    __m512i x2 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[2], in + 128), bswap);
+    __m512i x3 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[3], in + 192), bswap);
+    transpose_512(x0, x1, x2, x3);
+
+    for (int i = 0; i < 32; i += 4) {
+        x0 = sm4_round_512(x0, x1, x2, x3, _mm512_set1_epi32((int)rk[i]), m1, m2);
+        x1 = sm4_round_512(x1, x2, x3, x0, _mm512_set1_epi32((int)rk[i + 1]), m1, m2);
+        x2 = sm4_round_512(x2, x3, x0, x1, _mm512_set1_epi32((int)rk[i + 2]), m1, m2);
+        x3 = sm4_round_512(x3, x0, x1, x2, _mm512_set1_epi32((int)rk[i + 3]), m1, m2);
+    }
+
+    // 反序变换R：输出(X35, X34, X33, X32)
+    transpose_512(x3, x2, x1, x0);
+    _mm512_mask_storeu_epi32(out, mask[0], _mm512_shuffle_epi8(x3, bswap));
+    _mm512_mask_storeu_epi32(out + 64, mask[1], _mm512_shuffle_epi8(x2, bswap));
+    _mm512_mask_storeu_epi32(out + 128, mask[2], _mm512_shuffle_epi8(x1, bswap));
+    _mm512_mask_storeu_epi32(out + 192, mask[3], _mm512_shuffle_epi8(x0, bswap));
+}
+
+void sm4_encrypt_gfni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    while (blocks > 0) {
+        size_t n = blocks < 16 ? blocks : 16;
+        sm4_gfni_x16(in, out, n, rk);
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+}
+
+// 批量密钥扩展：16个密钥各占zmm的一个32位通道，CK[i]充当轮密钥，线性变换换成L'
+static void expand_keys_x16(const uint8_t* keys, uint32_t* rk, size_t n) {
+    const __m512i bswap = _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    const __m512i m1 = _mm512_set1_epi64(SBOX_M1);
+    const __m512i m2 = _mm512_set1_epi64(SBOX_M2);
+
+    __mmask16 mask[4];
+    for (int k = 0; k < 4; k++) {
+        size_t valid = n > 4 * (size_t)k ? n - 4 * (size_t)k : 0;
+        mask[k] = valid >= 4 ? (__mmask16)0xFFFF : (__mmask16)((1u << (4 * valid)) - 1);
+    }
+    __m512i x0 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[0], keys), bswap);
+    __m512i x1 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[1], keys + 64), bswap);
+    __m512i x2 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[2], keys + 128), bswap);
+    __m512i x3 = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask[3], keys + 192), bswap);
+    transpose_512(x0, x1, x2, x3);
+    x0 = _mm512_xor_si512(x0, _mm512_set1_epi32((int)FK[0]));
+    x1 = _mm512_xor_si512(x1, _mm512_set1_epi32((int)FK[1]));
+    x2 = _mm512_xor_si512(x2, _mm512_set1_epi32((int)FK[2]));
+    x3 = _mm512_xor_si512(x3, _mm512_set1_epi32((int)FK[3]));
+
+    // 转置后第l个128位通道的第e个字属于第4e+l个密钥
+    alignas(64) uint32_t v[16];
+    for (int i = 0; i < 32; i++) {
+        __m512i t = _mm512_xor_si512(_mm512_ternarylogic_epi32(x1, x2, x3, 0x96), _mm512_set1_epi32((int)CK[i]));
+        t = _mm512_gf2p8affine_epi64_epi8(t, m1, SBOX_C1);
+        t = _mm512_gf2p8affineinv_epi64_epi8(t, m2, SBOX_C2);
+        __m512i k = _mm512_xor_si512(x0, _mm512_ternarylogic_epi32(t, _mm512_rol_epi32(t, 13), _mm512_rol_epi32(t, 23), 0x96));
+        _mm512_store_si512(v, k);
+        for (size_t j = 0; j < n; j++) rk[32 * j + i] = v[4 * (j % 4) + j / 4];
+        x0 = x1; x1 = x2; x2 = x3; x3 = k;
+    }
+}
+
+void sm4_expand_keys_gfni(const uint8_t* keys, uint32_t* rk, size_t n) {
+    while (n > 0) {
+        size_t m = n < 16 ? n : 16;
+        expand_keys_x16(keys, rk, m);
+        keys += 16 * m;
+        rk += 32 * m;
+        n -= m;
+    }
+}
+
+SM4_TARGET_END()
+
+#else
+
+// 非x86平台退回T-table实现
+void sm4_encrypt_gfni(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    sm4_encrypt_blocks(in, out, blocks, rk);
+}
+
+void sm4_expand_keys_gfni(const uint8_t* keys, uint32_t* rk, size_t n) {
+    for (size_t j = 0; j < n; j++) key_expansion(keys + 16 * j, rk + 32 * j);
+}
+
+#endif
@@ -0,0 +1,149 @@
+﻿#include "sm4_gcm.h"
+#include "../probe/probe.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+using namespace std;
+
+static inline uint64_t bswap64(uint64_t v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return bswap64(v);
+}
+
+// 逐位乘法：按Y从高到低的每一位累加V，V每步乘x（右移一位，溢出时异或R = 0xE1 || 0^120）
+u128 GF128_mul(const u128& X, const u128& Y) {
+    u128 Z = { 0, 0 };
+    u128 V = X;
+
+    for (int i = 0; i < 128; i++) {
+        uint64_t y_bit = i < 64 ? (Y.high >> (63 - i)) & 1 : (Y.low >> (127 - i)) & 1;
+        if (y_bit) {
+            Z.high ^= V.high;
+            Z.low ^= V.low;
+        }
+
+        bool carry = V.low & 1;
+        V.low = (V.low >> 1) | (V.high << 63);
+        V.high = V.high >> 1;
+        if (carry) {
+            V.high ^= 0xE100000000000000ULL;
+        }
+    }
+    return Z;
+}
+
+void sm4_ghash_bitwise(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    u128 y = *Y;
+    for (size_t i = 0; i < blocks; i++, data += 16) {
+        y.high ^= load_be64(data);
+        y.low ^= load_be64(data + 8);
+        y = GF128_mul(y, key->H);
+    }
+    *Y = y;
+}
+
+// 可供选择的GHASH实现，按优先级从高到低排列；init为空表示只需要H
+struct sm4_ghash_kernel {
+    const char* name;
+    void (*update)(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks);
+    void (*init)(sm4_ghash_key* key);
+    bool (*available)();
+};
+
+static bool always() { return true; }
+static bool has_pclmul() { return sm4_cpu().pclmul; }
+static bool has_vpclmul() { return sm4_cpu().pclmul && sm4_cpu().vpclmul && sm4_cpu().avx512; }
+
+static const sm4_ghash_kernel kernels[] = {
+    { "vpclmul", sm4_ghash_vpclmul, sm4_ghash_init_clmul, has_vpclmul },
+    { "pclmul", sm4_ghash_pclmul, sm4_ghash_init_clmul, has_pclmul },
+    { "shoup8", sm4_ghash_shoup8, sm4_ghash_init_shoup8, always },
+    { "shoup4", sm4_ghash_shoup4, sm4_ghash_init_shoup4, always },
+    { "bitwise", sm4_ghash_bitwise, nullptr, always },
+};
+static const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static const sm4_ghash_kernel* find_kernel(const char* name) {
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (strcmp(kernels[i].name, name) == 0) return &kernels[i];
+    }
+    return nullptr;
+}
+
+// 与SM4内核的选择方式相同：环境变量SM4_GHASH_IMPL可强制指定，否则选可用的最快实现
+static const sm4_ghash_kernel* select_kernel() {
+    const char* env = getenv("SM4_GHASH_IMPL");
+    if (env && *env && strcmp(env, "auto") != 0) {
+        const sm4_ghash_kernel* k = find_kernel(env);
+        if (k && k->available()) return k;
+        fprintf(stderr, "SM4_GHASH_IMPL=%s is not available on this CPU, using auto selection\n", env);
+    }
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (kernels[i].available()) return &kernels[i];
+    }
+    return &kernels[kernel_count - 1];
+}
+
+// 原子指针，理由同sm4_dispatch.cpp中的active_slot
+static atomic<const sm4_ghash_kernel*>& active_slot() {
+    static atomic<const sm4_ghash_kernel*> active{ select_kernel() };
+    return active;
+}
+
+static const sm4_ghash_kernel* active_kernel() {
+    return active_slot().load(memory_order_relaxed);
+}
+
+const char* sm4_ghash_impl_name() {
+    return active_kernel()->name;
+}
+
+bool sm4_ghash_set_impl(const char* name) {
+    const sm4_ghash_kernel* k = find_kernel(name);
+    if (!k || !k->available()) return false;
+    active_slot().store(k, memory_order_relaxed);
+    return true;
+}
+
+void sm4_ghash_init(sm4_ghash_key* key, const u128& H) {
+    key->H = H;
+    key->kernel = active_kernel();
+    if (key->kernel->init) key->kernel->init(key);
+}
+
+void sm4_ghash_update(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    PROBE(PROBE_GHASH, 16 * blocks, blocks);
+    key->kernel->update(key, Y, data, blocks);
+}
+
+u128 GHASH(const u128& H, const vector<uint8_t>& data) {
+    sm4_ghash_key key;
+    sm4_ghash_init(&key, H);
+
+    u128 Y{ 0, 0 };
+    size_t blocks = data.size() / 16;
+    sm4_ghash_update(&key, &Y, data.data(), blocks);
+
+    // 剩余字节补零成一个完整分组
+    size_t rem = data.size() % 16;
+    if (rem) {
+        uint8_t last[16] = { 0 };
+        memcpy(last, data.data() + 16 * blocks, rem);
+        sm4_ghash_update(&key, &Y, last, 1);
+    }
+    return Y;
+}
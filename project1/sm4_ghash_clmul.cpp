@@ -0,0 +1,182 @@
+﻿#include "sm4_gcm.h"
+
+#if defined(SM4_X86)
+#include "../common/intrin.h"
+
+using namespace std;
+
+// 无进位乘法GHASH
+// 分组字节逆序后作为128位整数，整数的第k位对应多项式的x^(127-k)。两个这样的整数做无进位乘法，
+// 得到的255位结果比GCM比特序差一位；预先把H乘以x^-1（整数左移一位，溢出时异或0xC2..01）
+// 即可省去对256位乘积的移位。乘法用Karatsuba（三次PCLMULQDQ），
+// 归约用两次与0xC200000000000000的无进位乘法完成（x^128 = x^7 + x^2 + x + 1）
+
+SM4_TARGET_BEGIN("pclmul,ssse3")
+
+static inline __m128i bswap_128(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+static inline __m128i swap_halves(__m128i x) {
+    return _mm_shuffle_epi32(x, 0x4e);
+}
+
+// 把256位乘积 hi·x^128 + mi·x^64 + lo 归约到128位
+static inline __m128i reduce(__m128i lo, __m128i mi, __m128i hi) {
+    const __m128i poly = _mm_set_epi64x((long long)0xC200000000000000ULL, 1);
+    __m128i t = _mm_clmulepi64_si128(poly, lo, 0x01);
+    mi = _mm_xor_si128(mi, _mm_xor_si128(swap_halves(lo), t));
+    t = _mm_clmulepi64_si128(poly, mi, 0x01);
+    return _mm_xor_si128(hi, _mm_xor_si128(swap_halves(mi), t));
+}
+
+// a·b，b为H^i·x^-1，bk为b的高低64位异或（Karatsuba中间项所用，在低64位）
+static inline __m128i gf_mul(__m128i a, __m128i b, __m128i bk) {
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    __m128i mi = _mm_clmulepi64_si128(_mm_xor_si128(a, swap_halves(a)), bk, 0x00);
+    mi = _mm_xor_si128(mi, _mm_xor_si128(lo, hi));
+    return reduce(lo, mi, hi);
+}
+
+static inline __m128i karatsuba_key(__m128i b) {
+    return _mm_xor_si128(b, swap_halves(b));
+}
+
+static inline __m128i load_u128(const u128& x) {
+    return _mm_set_epi64x((long long)x.high, (long long)x.low);
+}
+
+static inline void store_u128(u128* y, __m128i x) {
+    y->low = (uint64_t)_mm_cvtsi128_si64(x);
+    y->high = (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(x, x));
+}
+
+// 整数域中左移一位即乘以x^-1，最高位（x^0的系数）移出时加上x^-1 = x^127 + x^6 + x + 1
+static inline __m128i mul_x_inv(__m128i h) {
+    __m128i carry = _mm_shuffle_epi32(_mm_srai_epi32(h, 31), 0xff);
+    __m128i shifted = _mm_or_si128(_mm_slli_epi64(h, 1), _mm_srli_epi64(_mm_slli_si128(h, 8), 63));
+    const __m128i poly = _mm_set_epi64x((long long)0xC200000000000000ULL, 1);
+    return _mm_xor_si128(shifted, _mm_and_si128(carry, poly));
+}
+
+// 累加a·b的三个Karatsuba部分积，不归约
+static inline void mul_acc(__m128i a, __m128i b, __m128i bk, __m128i& lo, __m128i& mi, __m128i& hi) {
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mi = _mm_xor_si128(mi, _mm_clmulepi64_si128(_mm_xor_si128(a, swap_halves(a)), bk, 0x00));
+}
+
+static inline __m128i load_block(const uint8_t* p) {
+    return bswap_128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// n个分组（1 <= n <= 8）的聚合：Y' = (Y ^ X1)·H^n ^ X2·H^(n-1) ^ ... ^ Xn·H
+// n个乘法互不依赖，部分积异或到一起后只归约一次（归约是线性的）
+static inline __m128i ghash_aggregate(const __m128i* h, const __m128i* hk, __m128i y, const uint8_t* data, size_t n) {
+    h += 8 - n;
+    hk += 8 - n;
+    __m128i lo = _mm_setzero_si128(), mi = lo, hi = lo;
+    mul_acc(_mm_xor_si128(y, load_block(data)), h[0], hk[0], lo, mi, hi);
+    for (size_t j = 1; j < n; j++) mul_acc(load_block(data + 16 * j), h[j], hk[j], lo, mi, hi);
+    mi = _mm_xor_si128(mi, _mm_xor_si128(lo, hi));
+    return reduce(lo, mi, hi);
+}
+
+static inline void load_powers(const sm4_ghash_key* key, __m128i h[8], __m128i hk[8]) {
+    for (int i = 0; i < 8; i++) {
+        h[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(key->clmul_pow[i]));
+        hk[i] = karatsuba_key(h[i]);
+    }
+}
+
+void sm4_ghash_init_clmul(sm4_ghash_key* key) {
+    __m128i h = load_u128(key->H);
+    __m128i h1 = mul_x_inv(h);
+    __m128i h1k = karatsuba_key(h1);
+    __m128i p = h;
+    for (int i = 7; i >= 0; i--) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(key->clmul_pow[i]), mul_x_inv(p));
+        p = gf_mul(p, h1, h1k);
+    }
+}
+
+// 每8个分组一步：8次独立的乘法，1次归约，Y的依赖链缩短为每8个分组一次乘法加归约
+void sm4_ghash_pclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    __m128i h[8], hk[8];
+    load_powers(key, h, hk);
+    __m128i y = load_u128(*Y);
+    for (; blocks >= 8; blocks -= 8, data += 128) y = ghash_aggregate(h, hk, y, data, 8);
+    if (blocks) y = ghash_aggregate(h, hk, y, data, blocks);
+    store_u128(Y, y);
+}
+
+SM4_TARGET_END()
+
+// VPCLMULQDQ：两个zmm放8个分组，分别乘[H^8, H^7, H^6, H^5]与[H^4, H^3, H^2, H^1]，
+// 部分积在通道内累加，最后把4个通道异或到一起再做一次128位归约
+//   Y' = (Y ^ X1)·H^8 ^ X2·H^7 ^ ... ^ X8·H
+SM4_TARGET_BEGIN("pclmul,ssse3,avx2,avx512f,avx512bw,vpclmulqdq")
+
+static inline __m512i swap_halves_512(__m512i x) {
+    return _mm512_shuffle_epi32(x, (_MM_PERM_ENUM)0x4e);
+}
+
+static inline __m128i xor_lanes(__m512i x) {
+    __m256i a = _mm256_xor_si256(_mm512_castsi512_si256(x), _mm512_extracti64x4_epi64(x, 1));
+    return _mm_xor_si128(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+}
+
+static inline void mul_acc_512(__m512i x, __m512i h, __m512i hk, __m512i& lo, __m512i& mi, __m512i& hi) {
+    lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(x, h, 0x00));
+    hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(x, h, 0x11));
+    mi = _mm512_xor_si512(mi, _mm512_clmulepi64_epi128(_mm512_xor_si512(x, swap_halves_512(x)), hk, 0x00));
+}
+
+void sm4_ghash_vpclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    const __m512i bswap = _mm512_broadcast_i32x4(
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __m512i h_hi = _mm512_load_si512(key->clmul_pow[0]);
+    __m512i h_lo = _mm512_load_si512(key->clmul_pow[4]);
+    __m512i hk_hi = _mm512_xor_si512(h_hi, swap_halves_512(h_hi));
+    __m512i hk_lo = _mm512_xor_si512(h_lo, swap_halves_512(h_lo));
+    __m128i y = load_u128(*Y);
+
+    for (; blocks >= 8; blocks -= 8, data += 128) {
+        __m512i x0 = _mm512_shuffle_epi8(_mm512_loadu_si512(data), bswap);
+        __m512i x1 = _mm512_shuffle_epi8(_mm512_loadu_si512(data + 64), bswap);
+        x0 = _mm512_xor_si512(x0, _mm512_zextsi128_si512(y));
+        __m512i lo = _mm512_setzero_si512(), mi = lo, hi = lo;
+        mul_acc_512(x0, h_hi, hk_hi, lo, mi, hi);
+        mul_acc_512(x1, h_lo, hk_lo, lo, mi, hi);
+        __m128i l = xor_lanes(lo), h = xor_lanes(hi);
+        __m128i m = _mm_xor_si128(xor_lanes(mi), _mm_xor_si128(l, h));
+        y = reduce(l, m, h);
+    }
+
+    // 不足8个的分组用对应的低次幂聚合
+    if (blocks) {
+        __m128i h[8], hk[8];
+        load_powers(key, h, hk);
+        y = ghash_aggregate(h, hk, y, data, blocks);
+    }
+    store_u128(Y, y);
+}
+
+SM4_TARGET_END()
+
+#else
+
+// 非x86平台没有无进位乘法指令，调度器不会选中这些实现
+void sm4_ghash_init_clmul(sm4_ghash_key*) {
+}
+
+void sm4_ghash_pclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    sm4_ghash_bitwise(key, Y, data, blocks);
+}
+
+void sm4_ghash_vpclmul(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    sm4_ghash_bitwise(key, Y, data, blocks);
+}
+
+#endif
@@ -0,0 +1,134 @@
+﻿#include "sm4_gcm.h"
+#include <array>
+#include <cstring>
+#include <utility>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+using namespace std;
+
+// Shoup查表GHASH：预先算出H与每个W位（W = 4或8）值的乘积M，乘法按Horner法则从最后W位开始，
+// 每步 Z = Z·x^W ^ M[n]。Z·x^W即整体右移W位，移出的W位乘x^128后落在最高16位，查rem表补回
+
+// 移出的W位r对应x^(128-W)..x^127，乘x^W后按x^128 = x^7 + x^2 + x + 1展开；
+// 表项直接存放在最高16位，省去每步的移位
+template <int W>
+constexpr array<uint64_t, (1 << W)> make_rem() {
+    array<uint64_t, (1 << W)> t{};
+    for (int r = 0; r < (1 << W); r++) {
+        uint64_t v = 0;
+        for (int b = 0; b < W; b++) {
+            if (r & (1 << b)) v ^= 0xE100000000000000ULL >> (W - 1 - b);
+        }
+        t[r] = v;
+    }
+    return t;
+}
+
+static constexpr array<uint64_t, 16> rem_4bit = make_rem<4>();
+static constexpr array<uint64_t, 256> rem_8bit = make_rem<8>();
+static_assert(rem_4bit[1] == 0x1C20ULL << 48 && rem_4bit[8] == 0xE100ULL << 48, "rem_4bit生成错误");
+
+static inline uint64_t bswap64(uint64_t v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return bswap64(v);
+}
+
+// V·x：整体右移一位，溢出时异或R = 0xE1 || 0^120
+static inline u128 mul_x(u128 V) {
+    uint64_t carry = 0 - (V.low & 1);
+    V.low = (V.low >> 1) | (V.high << 63);
+    V.high = (V.high >> 1) ^ (carry & 0xE100000000000000ULL);
+    return V;
+}
+
+// M[2^k] = H·x^(W-1-k)（半字节/字节的最高位对应最低次项），其余表项由线性组合得到
+template <int W>
+static void build_table(u128* M, const u128& H) {
+    M[0] = { 0, 0 };
+    M[1 << (W - 1)] = H;
+    for (int i = 1 << (W - 2); i > 0; i >>= 1) M[i] = mul_x(M[i << 1]);
+    for (int i = 2; i < (1 << W); i <<= 1) {
+        for (int j = 1; j < i; j++) {
+            M[i + j].high = M[i].high ^ M[j].high;
+            M[i + j].low = M[i].low ^ M[j].low;
+        }
+    }
+}
+
+void sm4_ghash_init_shoup4(sm4_ghash_key* key) {
+    build_table<4>(key->shoup4, key->H);
+}
+
+void sm4_ghash_init_shoup8(sm4_ghash_key* key) {
+    build_table<8>(key->shoup8, key->H);
+}
+
+// Z = Z·x^W ^ M[n]：整体右移W位，移出的W位查rem表补回最高位
+template <int W>
+static inline void mul_step(u128& Z, const u128* M, const uint64_t* rem, uint64_t n) {
+    uint64_t r = Z.low & ((1u << W) - 1);
+    Z.low = ((Z.low >> W) | (Z.high << (64 - W))) ^ M[n].low;
+    Z.high = (Z.high >> W) ^ rem[r] ^ M[n].high;
+}
+
+// A·x^64：A.high移到低64位；A.low对应x^64..x^127，乘x^64后超出x^127，
+// 按x^128 = 1 + x + x^2 + x^7直接移位展开（不需要查表）
+static inline u128 mul_x64(const u128& A) {
+    uint64_t L = A.low;
+    u128 r;
+    r.high = L ^ (L >> 1) ^ (L >> 2) ^ (L >> 7);
+    r.low = A.high ^ (L << 63) ^ (L << 62) ^ (L << 57);
+    return r;
+}
+
+// y·H = Σ M[n_i]·x^(W·i)。单条Horner链的每一步都要等上一步的rem查表结果，
+// 因此把y的低64位与高64位拆成两条互不依赖的链交替推进（折叠表达式在编译期完全展开），
+// 最后 y·H = A·x^64 ^ B
+template <int W, size_t... I>
+static inline void mul_steps(u128& A, u128& B, const u128* M, const uint64_t* rem, u128 y, index_sequence<I...>) {
+    const uint64_t mask = (1u << W) - 1;
+    ((mul_step<W>(A, M, rem, (y.low >> (W * (I + 1))) & mask),
+        mul_step<W>(B, M, rem, (y.high >> (W * (I + 1))) & mask)), ...);
+}
+
+template <int W>
+static inline u128 mul_table(const u128* M, const uint64_t* rem, u128 y) {
+    const uint64_t mask = (1u << W) - 1;
+    u128 A = M[y.low & mask];
+    u128 B = M[y.high & mask];
+    mul_steps<W>(A, B, M, rem, y, make_index_sequence<64 / W - 1>());
+    A = mul_x64(A);
+    A.high ^= B.high;
+    A.low ^= B.low;
+    return A;
+}
+
+template <int W>
+static void ghash_table(const u128* M, const uint64_t* rem, u128* Y, const uint8_t* data, size_t blocks) {
+    u128 y = *Y;
+    for (size_t i = 0; i < blocks; i++, data += 16) {
+        y.high ^= load_be64(data);
+        y.low ^= load_be64(data + 8);
+        y = mul_table<W>(M, rem, y);
+    }
+    *Y = y;
+}
+
+void sm4_ghash_shoup4(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    ghash_table<4>(key->shoup4, rem_4bit.data(), Y, data, blocks);
+}
+
+void sm4_ghash_shoup8(const sm4_ghash_key* key, u128* Y, const uint8_t* data, size_t blocks) {
+    ghash_table<8>(key->shoup8, rem_8bit.data(), Y, data, blocks);
+}
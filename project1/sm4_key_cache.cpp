@@ -0,0 +1,131 @@
+﻿#include "sm4_key_cache.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// 清除内存中的密钥材料，volatile防止被编译器优化掉
+static void wipe(void* p, size_t n) {
+    volatile uint8_t* v = static_cast<volatile uint8_t*>(p);
+    while (n--) *v++ = 0;
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+sm4_key_cache::sm4_key_cache(size_t capacity) : capacity(capacity ? capacity : 1) {
+    random_device rd;
+    seed = ((uint64_t)rd() << 32) | rd();
+    index.reserve(this->capacity);
+}
+
+sm4_key_cache::~sm4_key_cache() {
+    clear();
+}
+
+uint64_t sm4_key_cache::fingerprint(const uint8_t key[16]) const {
+    uint64_t a, b;
+    memcpy(&a, key, 8);
+    memcpy(&b, key + 8, 8);
+    return mix64(mix64(a ^ seed) ^ b);
+}
+
+// 命中时把条目移到表头；指纹相同但密钥不同视为未命中（随后由insert替换）。调用前需持有锁
+bool sm4_key_cache::lookup(const uint8_t key[16], uint64_t fp, sm4_ctx* ctx) {
+    auto found = index.find(fp);
+    if (found == index.end() || memcmp(found->second->key, key, 16) != 0) {
+        miss_count++;
+        return false;
+    }
+    lru.splice(lru.begin(), lru, found->second);
+    *ctx = found->second->ctx;
+    hit_count++;
+    return true;
+}
+
+void sm4_key_cache::evict(entry_iter it) {
+    index.erase(it->fp);
+    wipe(&*it, sizeof(entry));
+    lru.erase(it);
+}
+
+void sm4_key_cache::insert(const uint8_t key[16], uint64_t fp, const sm4_ctx& ctx) {
+    auto found = index.find(fp);
+    if (found != index.end()) evict(found->second);
+    while (lru.size() >= capacity) evict(prev(lru.end()));
+
+    lru.emplace_front();
+    entry& e = lru.front();
+    memcpy(e.key, key, 16);
+    e.fp = fp;
+    e.ctx = ctx;
+    index[fp] = lru.begin();
+}
+
+void sm4_key_cache::get(const uint8_t key[16], sm4_ctx* ctx) {
+    uint64_t fp = fingerprint(key);
+    {
+        lock_guard<mutex> lock(m);
+        if (lookup(key, fp, ctx)) return;
+    }
+    // 密钥扩展在锁外完成，不阻塞其他线程的查询
+    sm4_set_key(ctx, key);
+    lock_guard<mutex> lock(m);
+    insert(key, fp, *ctx);
+}
+
+void sm4_key_cache::get_batch(const uint8_t* keys, size_t n, sm4_ctx* ctx) {
+    vector<size_t> miss;
+    vector<uint64_t> fps(n);
+    {
+        lock_guard<mutex> lock(m);
+        for (size_t i = 0; i < n; i++) {
+            fps[i] = fingerprint(keys + 16 * i);
+            if (!lookup(keys + 16 * i, fps[i], &ctx[i])) miss.push_back(i);
+        }
+    }
+    if (miss.empty()) return;
+
+    // 未命中的密钥收集到连续缓冲区，一次批量扩展
+    vector<uint8_t> miss_keys(16 * miss.size());
+    vector<sm4_ctx> miss_ctx(miss.size());
+    for (size_t j = 0; j < miss.size(); j++) {
+        memcpy(&miss_keys[16 * j], keys + 16 * miss[j], 16);
+    }
+    sm4_set_key_batch(miss_ctx.data(), miss_keys.data(), miss.size());
+
+    lock_guard<mutex> lock(m);
+    for (size_t j = 0; j < miss.size(); j++) {
+        ctx[miss[j]] = miss_ctx[j];
+        insert(keys + 16 * miss[j], fps[miss[j]], miss_ctx[j]);
+    }
+    wipe(miss_keys.data(), miss_keys.size());
+    wipe(miss_ctx.data(), miss_ctx.size() * sizeof(sm4_ctx));
+}
+
+void sm4_key_cache::clear() {
+    lock_guard<mutex> lock(m);
+    while (!lru.empty()) evict(lru.begin());
+}
+
+size_t sm4_key_cache::size() const {
+    lock_guard<mutex> lock(m);
+    return lru.size();
+}
+
+uint64_t sm4_key_cache::hits() const {
+    lock_guard<mutex> lock(m);
+    return hit_count;
+}
+
+uint64_t sm4_key_cache::misses() const {
+    lock_guard<mutex> lock(m);
+    return miss_count;
+}
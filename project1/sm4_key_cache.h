@@ -0,0 +1,47 @@
+﻿#pragma once
+// 多租户场景下的SM4密钥上下文缓存：按密钥指纹索引，容量满时淘汰最久未使用（LRU）的上下文
+#include "sm4.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+class sm4_key_cache {
+public:
+    explicit sm4_key_cache(size_t capacity);
+    ~sm4_key_cache();
+
+    sm4_key_cache(const sm4_key_cache&) = delete;
+    sm4_key_cache& operator=(const sm4_key_cache&) = delete;
+
+    // 取出key对应的上下文（复制到ctx），未命中时扩展密钥并加入缓存；可多线程调用
+    void get(const uint8_t key[16], sm4_ctx* ctx);
+
+    // 批量版本：keys为n个连续的16字节密钥，所有未命中的密钥合并为一次SIMD批量密钥扩展
+    void get_batch(const uint8_t* keys, size_t n, sm4_ctx* ctx);
+
+    void clear();
+    size_t size() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct entry {
+        uint8_t key[16];
+        uint64_t fp;
+        sm4_ctx ctx;
+    };
+    typedef std::list<entry>::iterator entry_iter;
+
+    uint64_t fingerprint(const uint8_t key[16]) const;
+    bool lookup(const uint8_t key[16], uint64_t fp, sm4_ctx* ctx);
+    void insert(const uint8_t key[16], uint64_t fp, const sm4_ctx& ctx);
+    void evict(entry_iter it);
+
+    size_t capacity;
+    uint64_t seed;                  // 每个缓存随机选取，外部无法构造指纹碰撞
+    std::list<entry> lru;           // 表头为最近使用的上下文
+    std::unordered_map<uint64_t, entry_iter> index;
+    mutable std::mutex m;
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+};
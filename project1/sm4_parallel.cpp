@@ -0,0 +1,285 @@
+﻿#include "sm4_gcm.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 每个任务处理的数据量：256KB，落在L2缓存内
+static const size_t CHUNK_BYTES = 256 * 1024;
+static const size_t CHUNK_BLOCKS = CHUNK_BYTES / 16;
+
+// 常驻线程池：run(tasks, fn)对0..tasks-1调用fn，调用线程也参与计算，全部完成后返回。
+// 每次run是一个独立的任务组，多个线程同时调用时各自的任务组排在同一个队列里，
+// 工作线程按顺序领取任务，调用方之间不互相等待
+class thread_pool {
+public:
+    ~thread_pool() { resize(0); }
+
+    // 可以与run同时调用：旧的工作线程做完手上的任务后退出，队列中的任务组由新线程和调用方继续完成
+    void resize(unsigned n) {
+        lock_guard<mutex> resize_lock(resize_mutex);
+        if (workers.size() == n) return;
+        {
+            lock_guard<mutex> lock(m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+        workers.clear();
+        {
+            lock_guard<mutex> lock(m);
+            stop = false;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            workers.emplace_back([this] { worker(); });
+        }
+        count = n;
+    }
+
+    size_t size() const { return count.load(memory_order_relaxed); }
+
+    void run(size_t tasks, const function<void(size_t)>& fn) {
+        task_group g(fn, tasks);
+        {
+            lock_guard<mutex> lock(m);
+            queue.push_back(&g);
+        }
+        wake.notify_all();
+
+        work(g);
+
+        // 任务已全部领走，移出队列（可能已被工作线程移出），再等正在执行的任务完成
+        unique_lock<mutex> lock(m);
+        auto it = find(queue.begin(), queue.end(), &g);
+        if (it != queue.end()) queue.erase(it);
+        done.wait(lock, [&] { return g.completed == g.tasks && g.active == 0; });
+    }
+
+private:
+    struct task_group {
+        task_group(const function<void(size_t)>& f, size_t n) : fn(f), tasks(n) {}
+        const function<void(size_t)>& fn;
+        const size_t tasks;
+        atomic<size_t> next{ 0 };
+        size_t completed = 0;   // 以下两项由m保护
+        size_t active = 0;      // 正在执行本组任务的工作线程数
+    };
+
+    void work(task_group& g) {
+        size_t i;
+        while ((i = g.next.fetch_add(1)) < g.tasks) {
+            g.fn(i);
+            lock_guard<mutex> lock(m);
+            if (++g.completed == g.tasks) done.notify_all();
+        }
+    }
+
+    void worker() {
+        unique_lock<mutex> lock(m);
+        for (;;) {
+            wake.wait(lock, [&] { return stop || !queue.empty(); });
+            if (stop) return;
+            task_group* g = queue.front();
+            if (g->next.load() >= g->tasks) {
+                queue.erase(queue.begin());
+                continue;
+            }
+            g->active++;
+            lock.unlock();
+
+            work(*g);
+
+            lock.lock();
+            if (--g->active == 0 && g->completed == g->tasks) done.notify_all();
+        }
+    }
+
+    mutex resize_mutex;
+    mutex m;
+    condition_variable wake, done;
+    vector<thread> workers;
+    atomic<size_t> count{ 0 };
+    vector<task_group*> queue;
+    bool stop = false;
+};
+
+static unsigned default_threads() {
+    unsigned n = thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+static atomic<unsigned> thread_count{ 0 };   // 0表示使用CPU核数
+
+// 线程池按需创建，工作线程数为总线程数减一（调用线程也参与）；线程数未变时不加锁
+static thread_pool& pool() {
+    static thread_pool p;
+    unsigned want = sm4_threads() - 1;
+    if (p.size() != want) p.resize(want);
+    return p;
+}
+
+void sm4_set_threads(unsigned n) {
+    thread_count = n;
+}
+
+unsigned sm4_threads() {
+    unsigned n = thread_count.load();
+    return n ? n : default_threads();
+}
+
+static void ecb_mt(const uint32_t* rk, const uint8_t* in, uint8_t* out, size_t blocks) {
+    size_t chunks = (blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+    if (chunks < 2 || sm4_threads() < 2) {
+        sm4_crypt_blocks(rk, in, out, blocks);
+        return;
+    }
+    pool().run(chunks, [&](size_t i) {
+        size_t first = i * CHUNK_BLOCKS;
+        size_t n = blocks - first < CHUNK_BLOCKS ? blocks - first : CHUNK_BLOCKS;
+        sm4_crypt_blocks(rk, in + 16 * first, out + 16 * first, n);
+    });
+}
+
+void sm4_ecb_encrypt_mt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks) {
+    ecb_mt(ctx->rk_enc, in, out, blocks);
+}
+
+void sm4_ecb_decrypt_mt(const sm4_ctx* ctx, const uint8_t* in, uint8_t* out, size_t blocks) {
+    ecb_mt(ctx->rk_dec, in, out, blocks);
+}
+
+// 每个任务从counter + 任务序号 * CHUNK_BLOCKS开始，结果与串行CTR完全一致
+bool sm4_ctr_crypt_mt(const sm4_ctx* ctx, uint8_t counter[16], int ctr_bits,
+    const uint8_t* in, uint8_t* out, size_t len) {
+    size_t chunks = (len + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    if (chunks < 2 || sm4_threads() < 2) {
+        return sm4_ctr_crypt(ctx, counter, ctr_bits, in, out, len);
+    }
+    // 与串行接口相同，只接受32、64、128位计数器，在启动线程池之前检查
+    if (ctr_bits != 32 && ctr_bits != 64 && ctr_bits != 128) return false;
+    pool().run(chunks, [&](size_t i) {
+        size_t off = i * CHUNK_BYTES;
+        size_t n = len - off < CHUNK_BYTES ? len - off : CHUNK_BYTES;
+        uint8_t c[16];
+        memcpy(c, counter, 16);
+        sm4_ctr_add(c, ctr_bits, (uint64_t)i * CHUNK_BLOCKS);
+        sm4_ctr_crypt(ctx, c, ctr_bits, in + off, out + off, n);
+    });
+    return sm4_ctr_add(counter, ctr_bits, (len + 15) / 16);
+}
+
+// 各扇区互不依赖，按约256KB一组分给线程池
+static bool xts_sectors_mt(const sm4_xts_ctx* ctx, bool enc, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    if (sector_size < 16) return false;
+    size_t per_chunk = sector_size < CHUNK_BYTES ? CHUNK_BYTES / sector_size : 1;
+    size_t chunks = (sectors + per_chunk - 1) / per_chunk;
+    auto run = enc ? sm4_xts_encrypt_sectors : sm4_xts_decrypt_sectors;
+    if (chunks < 2 || sm4_threads() < 2) {
+        return run(ctx, sector, sector_size, in, out, sectors);
+    }
+    pool().run(chunks, [&](size_t i) {
+        size_t first = i * per_chunk;
+        size_t n = sectors - first < per_chunk ? sectors - first : per_chunk;
+        run(ctx, sector + first, sector_size, in + first * sector_size, out + first * sector_size, n);
+    });
+    return true;
+}
+
+bool sm4_xts_encrypt_sectors_mt(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    return xts_sectors_mt(ctx, true, sector, sector_size, in, out, sectors);
+}
+
+bool sm4_xts_decrypt_sectors_mt(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    return xts_sectors_mt(ctx, false, sector, sector_size, in, out, sectors);
+}
+
+// H^n，平方-乘，每段只在合并时用到几次，直接用逐位乘法
+static u128 gf_pow(const u128& H, uint64_t n) {
+    u128 r{ 0x8000000000000000ULL, 0 };     // 乘法单位元（x^0）
+    u128 p = H;
+    for (; n; n >>= 1) {
+        if (n & 1) r = GF128_mul(r, p);
+        p = GF128_mul(p, p);
+    }
+    return r;
+}
+
+// GHASH是线性的：整段消息的GHASH等于各段从0开始的GHASH按 S = S·H^(段内分组数) ^ S_i 依次合并。
+// 每段复制一份流式上下文，从各自的计数器开始做拼接的CTR + GHASH；第0段接着附加数据的GHASH值，
+// 最后一段不完整的分组留在它的携带缓冲中，合并后交给sm4_gcm_final统一补零。
+// 长度超过SP 800-38D上限时在启动线程池之前返回false，标签置零，不访问in/out
+static bool gcm_mt(const sm4_ctx* ctx, bool decrypt, const uint8_t* iv, size_t iv_len,
+    const uint8_t* aad, size_t aad_len, const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]) {
+    sm4_gcm_ctx g;
+    sm4_gcm_init(&g, ctx, iv, iv_len, decrypt);
+    if (len > SM4_GCM_MAX_TEXT || !sm4_gcm_aad(&g, aad, aad_len)) {
+        memset(tag, 0, 16);
+        return false;
+    }
+    sm4_gcm_update(&g, in, out, 0);     // 附加数据的最后一个分组补零并进入正文阶段
+
+    size_t chunks = (len + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    if (chunks < 2 || sm4_threads() < 2) {
+        sm4_gcm_update(&g, in, out, len);
+        return sm4_gcm_final(&g, tag);
+    }
+
+    vector<u128> partial(chunks);
+    uint8_t tail[16];
+    size_t tail_len = 0;
+    pool().run(chunks, [&](size_t i) {
+        size_t off = i * CHUNK_BYTES;
+        size_t n = len - off < CHUNK_BYTES ? len - off : CHUNK_BYTES;
+        sm4_gcm_ctx p = g;
+        if (i > 0) p.S = u128{ 0, 0 };
+        sm4_ctr_add(p.ctr, 32, (uint64_t)i * CHUNK_BLOCKS);
+        sm4_gcm_update(&p, in + off, out + off, n);
+        partial[i] = p.S;
+        if (i + 1 == chunks) {
+            memcpy(tail, p.buf, 16);
+            tail_len = p.buf_len;
+        }
+    });
+
+    u128 H_chunk = gf_pow(g.ghash.H, CHUNK_BLOCKS);
+    u128 S = partial[0];
+    for (size_t i = 1; i < chunks; i++) {
+        size_t n = i + 1 < chunks ? CHUNK_BLOCKS : (len - i * CHUNK_BYTES) / 16;
+        S = GF128_mul(S, n == CHUNK_BLOCKS ? H_chunk : gf_pow(g.ghash.H, n));
+        S.high ^= partial[i].high;
+        S.low ^= partial[i].low;
+    }
+
+    g.S = S;
+    memcpy(g.buf, tail, 16);
+    g.buf_len = tail_len;
+    g.text_len = len;
+    return sm4_gcm_final(&g, tag);
+}
+
+bool sm4_gcm_encrypt_mt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]) {
+    return gcm_mt(ctx, false, iv, iv_len, aad, aad_len, in, out, len, tag);
+}
+
+bool sm4_gcm_decrypt_mt(const sm4_ctx* ctx, const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+    const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]) {
+    uint8_t expected[16];
+    if (!gcm_mt(ctx, true, iv, iv_len, aad, aad_len, in, out, len, expected)) return false;
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; i++) diff |= expected[i] ^ tag[i];
+    if (diff != 0) {
+        memset(out, 0, len);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+﻿#pragma once
+// 编译期生成的SM4查找表：S盒与线性变换L合并成T表，T(x) = L(τ(x))
+// 表的布局作为模板参数，可按与SM4同时运行的其他代码对L1缓存的占用来选择
+#include "sm4.h"
+#include <array>
+
+enum class sm4_layout {
+    sbox,   // 只查S盒（256B），L用循环移位计算
+    t8x1,   // 1张8位T表（1KB），其余三个字节位置由循环移位得到（project1-b.cpp的布局）
+    t8x4,   // 每个字节位置一张8位T表，共4KB（T-table优化.cpp的布局）
+    t16,    // 1张16位T表（256KB），每轮只需两次查表
+};
+
+namespace sm4_detail {
+
+constexpr uint32_t rotl(uint32_t x, int n) {
+    return (x << (n & 31)) | (x >> ((32 - n) & 31));
+}
+
+constexpr uint32_t L(uint32_t x) {
+    return x ^ rotl(x, 2) ^ rotl(x, 10) ^ rotl(x, 18) ^ rotl(x, 24);
+}
+
+// L与循环移位可交换，因此各字节位置的T表都是最高字节T表的循环移位
+constexpr std::array<uint32_t, 256> make_t8(int shift) {
+    std::array<uint32_t, 256> t{};
+    for (int i = 0; i < 256; i++) t[i] = L((uint32_t)Sbox[i] << shift);
+    return t;
+}
+
+constexpr std::array<uint32_t, 65536> make_t16() {
+    std::array<uint32_t, 65536> t{};
+    for (uint32_t i = 0; i < 65536; i++) t[i] = L(((uint32_t)Sbox[i >> 8] << 24) | ((uint32_t)Sbox[i & 0xFF] << 16));
+    return t;
+}
+
+template <sm4_layout Layout> struct tables;
+
+template <> struct tables<sm4_layout::sbox> {
+    static constexpr size_t bytes = sizeof(Sbox);
+    static inline uint32_t t(uint32_t x) {
+        uint32_t b = ((uint32_t)Sbox[x >> 24] << 24) | ((uint32_t)Sbox[(x >> 16) & 0xFF] << 16) |
+            ((uint32_t)Sbox[(x >> 8) & 0xFF] << 8) | Sbox[x & 0xFF];
+        return L(b);
+    }
+};
+
+template <> struct tables<sm4_layout::t8x1> {
+    static constexpr std::array<uint32_t, 256> T = make_t8(24);
+    static constexpr size_t bytes = sizeof(T);
+    static inline uint32_t t(uint32_t x) {
+        return T[x >> 24] ^ rotl(T[(x >> 16) & 0xFF], 24) ^ rotl(T[(x >> 8) & 0xFF], 16) ^ rotl(T[x & 0xFF], 8);
+    }
+};
+
+template <> struct tables<sm4_layout::t8x4> {
+    static constexpr std::array<uint32_t, 256> T[4] = { make_t8(24), make_t8(16), make_t8(8), make_t8(0) };
+    static constexpr size_t bytes = sizeof(T);
+    static inline uint32_t t(uint32_t x) {
+        return T[0][x >> 24] ^ T[1][(x >> 16) & 0xFF] ^ T[2][(x >> 8) & 0xFF] ^ T[3][x & 0xFF];
+    }
+};
+
+template <> struct tables<sm4_layout::t16> {
+    static constexpr std::array<uint32_t, 65536> T = make_t16();
+    static constexpr size_t bytes = sizeof(T);
+    static inline uint32_t t(uint32_t x) {
+        return T[x >> 16] ^ rotl(T[x & 0xFFFF], 16);
+    }
+};
+
+// 表在编译期生成：T(x)对单字节输入等于L(S(x))
+static_assert(tables<sm4_layout::t8x1>::T[0x01] == L((uint32_t)0x90 << 24), "T表生成错误");
+static_assert(tables<sm4_layout::t8x4>::T[3][0xff] == L(0x48), "T表生成错误");
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+} // namespace sm4_detail
+
+// 按指定布局查表的单分组加密（rk传入rk_dec即为解密）
+template <sm4_layout Layout>
+inline void sm4_encrypt_with(const uint8_t in[16], uint8_t out[16], const uint32_t rk[32]) {
+    using tab = sm4_detail::tables<Layout>;
+    uint32_t x0 = sm4_detail::load_be32(in);
+    uint32_t x1 = sm4_detail::load_be32(in + 4);
+    uint32_t x2 = sm4_detail::load_be32(in + 8);
+    uint32_t x3 = sm4_detail::load_be32(in + 12);
+    for (int r = 0; r < 32; r += 4) {
+        x0 ^= tab::t(x1 ^ x2 ^ x3 ^ rk[r]);
+        x1 ^= tab::t(x2 ^ x3 ^ x0 ^ rk[r + 1]);
+        x2 ^= tab::t(x3 ^ x0 ^ x1 ^ rk[r + 2]);
+        x3 ^= tab::t(x0 ^ x1 ^ x2 ^ rk[r + 3]);
+    }
+    sm4_detail::store_be32(out, x3);
+    sm4_detail::store_be32(out + 4, x2);
+    sm4_detail::store_be32(out + 8, x1);
+    sm4_detail::store_be32(out + 12, x0);
+}
+
+// 与sm4_blocks_fn签名一致的多分组版本
+template <sm4_layout Layout>
+void sm4_encrypt_blocks_with(const uint8_t* in, uint8_t* out, size_t blocks, const uint32_t rk[32]) {
+    for (size_t i = 0; i < blocks; i++) {
+        sm4_encrypt_with<Layout>(in + 16 * i, out + 16 * i, rk);
+    }
+}
+
+// 各布局的表大小（字节）
+template <sm4_layout Layout>
+constexpr size_t sm4_table_bytes() {
+    return sm4_detail::tables<Layout>::bytes;
+}
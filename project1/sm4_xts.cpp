@@ -0,0 +1,252 @@
+﻿#include "sm4.h"
+#include <algorithm>
+#include <cstring>
+#if defined(SM4_X86)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// 每批处理的分组数（16KB）：512B扇区一批32个，4KB扇区一批4个
+static const size_t XTS_BATCH = 1024;
+
+// tweak按IEEE 1619的约定视为小端序的128位整数：T[0]为低64位，T[1]为高64位。
+// 与字节之间的转换显式按小端序进行，结果不依赖主机字节序
+static inline uint64_t load_le64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void store_le64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++, v >>= 8) p[i] = (uint8_t)v;
+}
+
+static inline void load_tweak(const uint8_t b[16], uint64_t T[2]) {
+    T[0] = load_le64(b);
+    T[1] = load_le64(b + 8);
+}
+
+static inline void store_tweak(uint8_t b[16], const uint64_t T[2]) {
+    store_le64(b, T[0]);
+    store_le64(b + 8, T[1]);
+}
+
+// 乘α即整体左移一位，最高位溢出时异或0x87
+static inline void gf_double(uint64_t T[2]) {
+    uint64_t carry = 0 - (T[1] >> 63);
+    T[1] = (T[1] << 1) | (T[0] >> 63);
+    T[0] = (T[0] << 1) ^ (carry & 0x87);
+}
+
+// out = in ^ t，共n个分组，允许out与in相同
+static inline void xor_blocks(uint8_t* out, const uint8_t* in, const uint8_t* t, size_t n) {
+    for (size_t i = 0; i < 2 * n; i++) {
+        uint64_t a, b;
+        memcpy(&a, in + 8 * i, 8);
+        memcpy(&b, t + 8 * i, 8);
+        a ^= b;
+        memcpy(out + 8 * i, &a, 8);
+    }
+}
+
+// 单个分组：out = E(in ^ T) ^ T
+static void xts_block(const uint32_t rk[32], const uint64_t T[2], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t buf[16], t[16];
+    store_tweak(t, T);
+    xor_blocks(buf, in, t, 1);
+    sm4_crypt_blocks(rk, buf, buf, 1);
+    xor_blocks(out, buf, t, 1);
+}
+
+// 连续blocks个分组：先生成一批tweak，异或后整体送入多分组内核，再异或一次
+// 结束后T为下一个分组的tweak
+static void xts_blocks(const uint32_t rk[32], uint64_t T[2], const uint8_t* in, uint8_t* out, size_t blocks) {
+    uint8_t tw[16 * XTS_BATCH];
+    while (blocks > 0) {
+        size_t n = min(blocks, XTS_BATCH);
+        for (size_t i = 0; i < n; i++) {
+            store_tweak(tw + 16 * i, T);
+            gf_double(T);
+        }
+        xor_blocks(out, in, tw, n);
+        sm4_crypt_blocks(rk, out, out, n);
+        xor_blocks(out, out, tw, n);
+
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+}
+
+// 一个数据单元（扇区）的加解密，len不是16的倍数时用密文窃取处理最后两个分组；
+// 不足一个分组时无法窃取，返回false，不写out
+static bool xts_crypt(const sm4_xts_ctx* ctx, bool enc, const uint8_t iv[16],
+    const uint8_t* in, uint8_t* out, size_t len) {
+    if (len < 16) return false;
+    const uint32_t* rk = enc ? ctx->data.rk_enc : ctx->data.rk_dec;
+    uint64_t T[2];
+    uint8_t t[16];
+    sm4_crypt_blocks(ctx->tweak.rk_enc, iv, t, 1);
+    load_tweak(t, T);
+
+    size_t blocks = len / 16, r = len % 16;
+    if (r == 0) {
+        xts_blocks(rk, T, in, out, blocks);
+        return true;
+    }
+    xts_blocks(rk, T, in, out, blocks - 1);
+    in += 16 * (blocks - 1);
+    out += 16 * (blocks - 1);
+
+    // T对应倒数第二个分组（第m-1个），T2 = T·α对应被窃取后的最后一个完整分组
+    uint64_t T2[2] = { T[0], T[1] };
+    gf_double(T2);
+    uint8_t full[16], stolen[16];
+    if (enc) {
+        // CC = E(P_{m-1})，C_m = CC的前r字节，C_{m-1} = E(P_m || CC的后16-r字节)
+        xts_block(rk, T, in, full);
+        memcpy(stolen, in + 16, r);
+        memcpy(stolen + r, full + r, 16 - r);
+        memcpy(out + 16, full, r);
+        xts_block(rk, T2, stolen, out);
+    }
+    else {
+        // 解密时两个tweak的使用顺序相反
+        xts_block(rk, T2, in, full);
+        memcpy(stolen, in + 16, r);
+        memcpy(stolen + r, full + r, 16 - r);
+        memcpy(out + 16, full, r);
+        xts_block(rk, T, stolen, out);
+    }
+    return true;
+}
+
+// 扇区批量：g个扇区各nb个分组，由各扇区的初始tweak t0生成全部tweak，tw[(s·nb + j)·16]
+// 各扇区的tweak链互不依赖，AVX2下每个ymm同时推进两个扇区
+static void sector_tweaks_scalar(const uint8_t* t0, size_t g, size_t nb, uint8_t* tw) {
+    for (size_t s = 0; s < g; s++) {
+        uint64_t T[2];
+        load_tweak(t0 + 16 * s, T);
+        for (size_t j = 0; j < nb; j++) {
+            store_tweak(tw + 16 * (s * nb + j), T);
+            gf_double(T);
+        }
+    }
+}
+
+#if defined(SM4_X86)
+SM4_TARGET_BEGIN("avx2")
+
+// 每个128位通道独立乘α：各32位字左移一位，移出的最高位进入上一个字，最高字的溢出回到最低字异或0x87
+static inline __m256i gf_double_256(__m256i t) {
+    const __m256i poly = _mm256_setr_epi32(0x87, 1, 1, 1, 0x87, 1, 1, 1);
+    __m256i carry = _mm256_srai_epi32(t, 31);
+    carry = _mm256_and_si256(_mm256_shuffle_epi32(carry, 0x93), poly);
+    return _mm256_xor_si256(_mm256_add_epi32(t, t), carry);
+}
+
+static void sector_tweaks_avx2(const uint8_t* t0, size_t g, size_t nb, uint8_t* tw) {
+    size_t s = 0;
+    for (; s + 4 <= g; s += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t0 + 16 * s));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t0 + 16 * s + 32));
+        uint8_t* p = tw + 16 * s * nb;
+        for (size_t j = 0; j < nb; j++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * j), _mm256_castsi256_si128(a));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * (nb + j)), _mm256_extracti128_si256(a, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * (2 * nb + j)), _mm256_castsi256_si128(b));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * (3 * nb + j)), _mm256_extracti128_si256(b, 1));
+            a = gf_double_256(a);
+            b = gf_double_256(b);
+        }
+    }
+    sector_tweaks_scalar(t0 + 16 * s, g - s, nb, tw + 16 * s * nb);
+}
+
+SM4_TARGET_END()
+#endif
+
+static void sector_tweaks(const uint8_t* t0, size_t g, size_t nb, uint8_t* tw) {
+#if defined(SM4_X86)
+    if (sm4_cpu().avx2) {
+        sector_tweaks_avx2(t0, g, nb, tw);
+        return;
+    }
+#endif
+    sector_tweaks_scalar(t0, g, nb, tw);
+}
+
+// 扇区号按小端序写入128位tweak分组
+static inline void sector_iv(uint8_t iv[16], uint64_t sector) {
+    store_le64(iv, sector);
+    memset(iv + 8, 0, 8);
+}
+
+static bool xts_sectors(const sm4_xts_ctx* ctx, bool enc, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    if (sector_size < 16) return false;
+    size_t nb = sector_size / 16;
+
+    // 扇区大小不是16的倍数（需要密文窃取）或一批放不下一个扇区时逐扇区处理
+    if (sector_size % 16 != 0 || nb == 0 || nb > XTS_BATCH) {
+        for (size_t s = 0; s < sectors; s++) {
+            uint8_t iv[16];
+            sector_iv(iv, sector + s);
+            xts_crypt(ctx, enc, iv, in + s * sector_size, out + s * sector_size, sector_size);
+        }
+        return true;
+    }
+
+    const uint32_t* rk = enc ? ctx->data.rk_enc : ctx->data.rk_dec;
+    size_t per_batch = XTS_BATCH / nb;
+    uint8_t t0[16 * XTS_BATCH];
+    uint8_t tw[16 * XTS_BATCH];
+    while (sectors > 0) {
+        size_t g = min(sectors, per_batch);
+
+        // 一批扇区的初始tweak E_K2(扇区号)也通过多分组内核一次算出
+        for (size_t s = 0; s < g; s++) sector_iv(t0 + 16 * s, sector + s);
+        sm4_crypt_blocks(ctx->tweak.rk_enc, t0, t0, g);
+        sector_tweaks(t0, g, nb, tw);
+
+        size_t n = g * nb;
+        xor_blocks(out, in, tw, n);
+        sm4_crypt_blocks(rk, out, out, n);
+        xor_blocks(out, out, tw, n);
+
+        in += 16 * n;
+        out += 16 * n;
+        sector += g;
+        sectors -= g;
+    }
+    return true;
+}
+
+bool sm4_xts_set_key(sm4_xts_ctx* ctx, const uint8_t key[32]) {
+    // 两半密钥相同时XTS退化为弱构造；常数时间比较，耗时与第一个不同字节的位置无关
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; i++) diff |= key[i] ^ key[16 + i];
+    if (diff == 0) return false;
+    sm4_set_key(&ctx->data, key);
+    sm4_set_key(&ctx->tweak, key + 16);
+    return true;
+}
+
+bool sm4_xts_encrypt(const sm4_xts_ctx* ctx, const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) {
+    return xts_crypt(ctx, true, iv, in, out, len);
+}
+
+bool sm4_xts_decrypt(const sm4_xts_ctx* ctx, const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) {
+    return xts_crypt(ctx, false, iv, in, out, len);
+}
+
+bool sm4_xts_encrypt_sectors(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    return xts_sectors(ctx, true, sector, sector_size, in, out, sectors);
+}
+
+bool sm4_xts_decrypt_sectors(const sm4_xts_ctx* ctx, uint64_t sector, size_t sector_size,
+    const uint8_t* in, uint8_t* out, size_t sectors) {
+    return xts_sectors(ctx, false, sector, sector_size, in, out, sectors);
+}
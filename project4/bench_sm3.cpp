@@ -0,0 +1,289 @@
+﻿#include "sm3.h"
+#include "sm3_mb.h"
+#include "sm3_hmac.h"
+#include "../probe/probe.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 标准测试向量（GB/T 32905-2016 附录A）
+static const char* ABC_DIGEST = "66c7f0f462eeedd9d1f2d46bdc10e4e24167c4875cf2f7a2297da02b8f4ba8e0";
+static const char* ABCD16_DIGEST = "debe9ff92275b8a138604889c18e5a4d6fdb70e5387e5765293dcba39c0c5732";
+
+// 反复运行fn至少0.5秒，返回每次调用的平均秒数
+template <class F>
+static double seconds_per_call(F fn) {
+    fn();
+    size_t iters = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed;
+    do {
+        fn();
+        iters++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < 0.5);
+    return elapsed / iters;
+}
+
+// 每次调用处理bytes字节时的MB/s
+template <class F>
+static double measure(size_t bytes, F fn) {
+    return bytes / seconds_per_call(fn) / (1024 * 1024);
+}
+
+// 按定义直接计算的HMAC-SM3，每次都重新压缩K ^ ipad与K ^ opad两个分组，作为对照
+static void hmac_naive(const uint8_t* key, size_t key_len, const uint8_t* data, size_t len, uint8_t out[32]) {
+    uint8_t k[64] = {}, pad[64], d[32];
+    if (key_len > 64) sm3_hash(key, key_len, k);
+    else if (key_len) memcpy(k, key, key_len);
+    SM3 h;
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    h.update(pad, 64);
+    h.update(data, len);
+    h.finalize();
+    h.digest(d);
+    h.reset();
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5C;
+    h.update(pad, 64);
+    h.update(d, 32);
+    h.finalize();
+    h.digest(out);
+}
+
+// HMAC：各种密钥长度（含0、64、超过64需先压缩）与消息长度，一次计算、分段update、verify都与按定义的计算一致
+static bool check_hmac(const vector<uint8_t>& pool) {
+    mt19937 gen(15852);
+    for (size_t key_len : { 0, 1, 16, 32, 63, 64, 65, 100, 200 }) {
+        const uint8_t* key = pool.data() + gen() % 4096;
+        sm3_hmac_key k(key, key_len);
+        for (size_t i = 0; i < 200; i++) {
+            size_t len = i < 150 ? i : gen() % 5000;
+            const uint8_t* p = pool.data() + gen() % (pool.size() - len);
+            uint8_t ref[32], mac[32], split[32];
+            hmac_naive(key, key_len, p, len, ref);
+            k.mac(p, len, mac);
+            sm3_hmac h(k);
+            size_t half = len / 3;
+            h.update(p, half);
+            h.update(p + half, len - half);
+            h.finalize(split);
+            if (memcmp(mac, ref, 32) != 0 || memcmp(split, ref, 32) != 0) return false;
+            if (!k.verify(p, len, ref) || !k.verify(p, len, ref, 16)) return false;
+            ref[i % 32] ^= 1;
+            if (k.verify(p, len, ref)) return false;
+        }
+    }
+    return true;
+}
+
+// HMAC批量验证：部分tag被改动，逐条的ok与通过条数都要正确
+static bool check_hmac_batch(const vector<uint8_t>& pool) {
+    mt19937 gen(2104);
+    const uint8_t* key = pool.data() + 100;
+    sm3_hmac_key k(key, 20);
+    size_t n = 1000, expect = 0;
+    vector<sm3_hmac_job> jobs(n);
+    vector<array<uint8_t, 32>> tags(n);
+    for (size_t i = 0; i < n; i++) {
+        size_t len = i < 300 ? i : gen() % 5000;
+        const uint8_t* p = pool.data() + gen() % (pool.size() - len);
+        hmac_naive(key, 20, p, len, tags[i].data());
+        if (i % 7 == 3) tags[i][gen() % 32] ^= 0x80;
+        else expect++;
+        jobs[i] = sm3_hmac_job{ p, len, {}, tags[i].data(), false };
+    }
+    if (sm3_hmac_verify_batch(k, jobs.data(), n) != expect) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (jobs[i].ok != (i % 7 != 3)) return false;
+    }
+    return true;
+}
+
+// 多路SM3：各种长度（含0、55/56/64等填充边界）混在一起，与sm3_hash逐条比对，并检查每个任务恰好返回一次
+static bool check_mb(const vector<uint8_t>& pool) {
+    mt19937 gen(2024);
+    vector<sm3_job> jobs(1000);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        size_t len = i < 300 ? i : gen() % 5000;
+        jobs[i] = sm3_job{ pool.data() + gen() % (pool.size() - len), len, {}, nullptr };
+    }
+
+    sm3_mb_manager m;
+    size_t returned = 0;
+    for (auto& j : jobs) {
+        if (m.submit(&j)) returned++;
+    }
+    while (m.flush()) returned++;
+    if (returned != jobs.size()) return false;
+
+    for (auto& j : jobs) {
+        if (sm3_to_hex(j.digest) != sm3_hash(string(reinterpret_cast<const char*>(j.data), j.len))) return false;
+    }
+    return true;
+}
+
+// 单条消息：各长度并随机切分update，摘要列表用于不同实现之间逐条比对
+static vector<string> digests_split(const vector<uint8_t>& pool) {
+    mt19937 gen(99);
+    vector<string> out;
+    for (size_t i = 0; i < 400; i++) {
+        size_t len = i < 300 ? i : gen() % 100000;
+        const uint8_t* p = pool.data() + gen() % (pool.size() - len);
+        SM3 sm3;
+        for (size_t off = 0; off < len;) {
+            size_t n = min<size_t>(len - off, gen() % 300);
+            sm3.update(p + off, n);
+            off += n;
+        }
+        sm3.finalize();
+        out.push_back(sm3.digest());
+    }
+    return out;
+}
+
+int main() {
+    // 正确性
+    string abcd16;
+    for (int i = 0; i < 16; i++) abcd16 += "abcd";
+    bool ok = sm3_hash("abc") == ABC_DIGEST && sm3_hash(abcd16) == ABCD16_DIGEST;
+
+    // 分多次update与一次update结果相同
+    string msg(1000, 0);
+    for (size_t i = 0; i < msg.size(); i++) msg[i] = static_cast<char>(i * 7 + 3);
+    SM3 split;
+    for (size_t off = 0, step = 1; off < msg.size(); off += step, step = step * 3 % 97 + 1) {
+        size_t n = min(step, msg.size() - off);
+        split.update(reinterpret_cast<const uint8_t*>(msg.data() + off), n);
+    }
+    split.finalize();
+    ok = ok && split.digest() == sm3_hash(msg);
+
+    // 复制上下文得到中间状态的克隆：共享前缀后分别继续，与整条消息的摘要相同
+    const uint8_t* m = reinterpret_cast<const uint8_t*>(msg.data());
+    SM3 prefix;
+    prefix.update(m, 100);
+    SM3 a = prefix, b = prefix;
+    a.update(m + 100, 900);
+    b.update(m + 100, 27);
+    a.finalize();
+    b.finalize();
+    uint8_t da[32], db[32], ref_a[32], ref_b[32];
+    a.digest(da);
+    b.digest(db);
+    sm3_hash(m, 1000, ref_a);
+    sm3_hash(m, 127, ref_b);
+    ok = ok && memcmp(da, ref_a, 32) == 0 && memcmp(db, ref_b, 32) == 0 && sm3_to_hex(da) == sm3_hash(msg);
+
+    cout << "SM3(\"SDUCST\") = " << sm3_hash("SDUCST") << endl;
+    cout << "SM3 test vectors: " << (ok ? "correct" : "MISMATCH") << endl;
+    if (!ok) return 1;
+
+    vector<uint8_t> pool(1 << 20);
+    mt19937 gen(7);
+    for (auto& b : pool) b = static_cast<uint8_t>(gen());
+
+    bool hmac_ok = check_hmac(pool);
+    cout << left << setw(18) << "hmac" << (hmac_ok ? "correct" : "MISMATCH") << endl;
+    if (!hmac_ok) return 1;
+
+    // 单条消息的各实现与原始标量写法逐条一致
+    string best_single = sm3_impl_name();
+    sm3_set_impl("scalar");
+    vector<string> ref = digests_split(pool);
+    for (const char* impl : { "ssse3" }) {
+        if (!sm3_set_impl(impl)) continue;
+        bool single_ok = digests_split(pool) == ref;
+        cout << left << setw(18) << impl << (single_ok ? "correct" : "MISMATCH") << endl;
+        if (!single_ok) return 1;
+    }
+    sm3_set_impl(best_single.c_str());
+
+    string best = sm3_mb_impl_name();
+    for (const char* impl : { "avx512-x16", "avx2-x8", "scalar" }) {
+        if (!sm3_mb_set_impl(impl)) continue;
+        bool mb_ok = check_mb(pool) && check_hmac_batch(pool);
+        cout << left << setw(18) << (string("mb ") + impl) << (mb_ok ? "correct" : "MISMATCH") << endl;
+        if (!mb_ok) return 1;
+    }
+    sm3_mb_set_impl(best.c_str());
+
+#if defined(CRYPTO_PROBE)
+    probe_enable_hw(true);
+    probe_reset();
+#endif
+
+    // 性能：与project4-a.cpp相同，1MB数据重复100次，依次使用各单条消息实现
+    string long_str(1024 * 1024, 'a');
+    const int iterations = 100;
+
+    for (const char* impl : { "scalar", "ssse3" }) {
+        if (!sm3_set_impl(impl)) continue;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            SM3 sm3;
+            sm3.update(reinterpret_cast<const uint8_t*>(long_str.data()), long_str.size());
+            sm3.finalize();
+            sm3.digest();
+        }
+        double total_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "\n[" << impl << "]" << endl;
+        cout << "Average time for 1MB data: " << total_time / iterations * 1000 << " ms" << endl;
+        cout << "Throughput: " << (long_str.size() * iterations / 1024.0 / 1024.0) / total_time << " MB/s" << endl;
+    }
+    sm3_set_impl(best_single.c_str());
+
+    // 大量短消息：逐条使用SM3类与多路批处理
+    cout << "\nmany messages (MB/s, " << sm3_mb_impl_name() << ")" << endl;
+    cout << left << setw(10) << "size" << setw(12) << "SM3" << setw(12) << "batch" << "speedup" << endl;
+    for (size_t size : { 64, 256, 1024, 4096 }) {
+        size_t n = (4 << 20) / size;
+        vector<sm3_job> jobs(n);
+        for (size_t i = 0; i < n; i++) jobs[i] = sm3_job{ pool.data() + i * size, size, {}, nullptr };
+        double one = measure(n * size, [&] {
+            for (auto& j : jobs) {
+                SM3 sm3;
+                sm3.update(j.data, j.len);
+                sm3.finalize();
+                sm3.digest(j.digest);
+            }
+        });
+        double batch = measure(n * size, [&] { sm3_hash_batch(jobs.data(), n); });
+        cout << left << setw(10) << size << fixed << setprecision(1) << setw(12) << one << setw(12) << batch
+            << setprecision(2) << batch / one << "x" << endl;
+    }
+
+    // HMAC：每条MAC的耗时，按定义计算、预先压缩ipad/opad的密钥对象、多路批量计算
+    cout << "\nHMAC-SM3 (ns per MAC)" << endl;
+    cout << left << setw(10) << "size" << setw(12) << "naive" << setw(12) << "keyed" << setw(12) << "batch"
+        << "keyed speedup" << endl;
+    const uint8_t* hkey = pool.data();
+    sm3_hmac_key hk(hkey, 32);
+    for (size_t size : { 16, 64, 256, 1024 }) {
+        size_t n = 4096;
+        vector<sm3_hmac_job> jobs(n);
+        for (size_t i = 0; i < n; i++) jobs[i] = sm3_hmac_job{ pool.data() + i * size, size, {}, nullptr, false };
+        double naive = seconds_per_call([&] {
+            for (auto& j : jobs) hmac_naive(hkey, 32, j.data, j.len, j.mac);
+        }) / n * 1e9;
+        double keyed = seconds_per_call([&] {
+            for (auto& j : jobs) hk.mac(j.data, j.len, j.mac);
+        }) / n * 1e9;
+        double batch = seconds_per_call([&] { sm3_hmac_batch(hk, jobs.data(), n); }) / n * 1e9;
+        cout << left << setw(10) << size << fixed << setprecision(1) << setw(12) << naive << setw(12) << keyed
+            << setw(12) << batch << setprecision(2) << naive / keyed << "x" << endl;
+    }
+
+#if defined(CRYPTO_PROBE)
+    cout << "probe: " << probe_to_json(probe_take_snapshot()) << endl;
+#endif
+    return 0;
+}
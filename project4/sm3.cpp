@@ -0,0 +1,299 @@
+﻿#include "sm3.h"
+#include "../probe/probe.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// 循环左移
+static inline uint32_t ROL(uint32_t x, uint32_t n) {
+    return (x << (n & 0x1F)) | (x >> ((32 - n) & 0x1F));
+}
+
+// 布尔函数宏定义
+#define FF0(X, Y, Z) ((X) ^ (Y) ^ (Z))
+#define FF1(X, Y, Z) (((X) & (Y)) | ((X) & (Z)) | ((Y) & (Z)))
+#define GG0(X, Y, Z) ((X) ^ (Y) ^ (Z))
+#define GG1(X, Y, Z) (((X) & (Y)) | ((~(X)) & (Z)))
+
+// 置换函数宏定义
+#define P0(X) ((X) ^ ROL(X, 9) ^ ROL(X, 17))
+#define P1(X) ((X) ^ ROL(X, 15) ^ ROL(X, 23))
+
+static const uint32_t T0 = 0x79CC4519;     // 第0～15轮
+static const uint32_t T1 = 0x7A879D8A;     // 第16～63轮
+
+const uint32_t SM3_IV[8] = {
+    0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
+    0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
+};
+
+void SM3::reset() {
+    memcpy(state, SM3_IV, sizeof(state));
+    total_len = 0;
+    buffer_len = 0;
+}
+
+void SM3::reset(const uint32_t iv[8], uint64_t prefix_len) {
+    memcpy(state, iv, sizeof(state));
+    total_len = prefix_len;
+    buffer_len = 0;
+}
+
+void SM3::update(const uint8_t* data, size_t len) {
+    PROBE(PROBE_SM3_UPDATE, len, (buffer_len + len) / 64);
+    total_len += len;
+    size_t offset = 0;
+
+    // 处理缓冲区中已有数据
+    if (buffer_len && len) {
+        size_t fill = min(64 - buffer_len, len);
+        memcpy(buffer + buffer_len, data, fill);
+        buffer_len += fill;
+        offset += fill;
+
+        if (buffer_len == 64) {
+            process_blocks(buffer, 1);
+            buffer_len = 0;
+        }
+    }
+
+    // 处理完整块：连续的分组一次交给压缩函数
+    size_t blocks = (len - offset) / 64;
+    if (blocks) {
+        process_blocks(data + offset, blocks);
+        offset += 64 * blocks;
+    }
+
+    // 保存剩余数据
+    if (offset < len) {
+        memcpy(buffer + buffer_len, data + offset, len - offset);
+        buffer_len += len - offset;
+    }
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+void SM3::finalize() {
+    uint64_t bit_len = total_len * 8;
+
+    // 添加填充：剩余数据之后放不下8字节长度时，先补零压缩这一组，长度放在下一组
+    buffer[buffer_len++] = 0x80;
+    if (buffer_len > 56) {
+        memset(buffer + buffer_len, 0, 64 - buffer_len);
+        process_blocks(buffer, 1);
+        buffer_len = 0;
+    }
+    memset(buffer + buffer_len, 0, 56 - buffer_len);
+
+    // 添加长度
+    store_be32(buffer + 56, static_cast<uint32_t>(bit_len >> 32));
+    store_be32(buffer + 60, static_cast<uint32_t>(bit_len));
+
+    // 处理填充块
+    process_blocks(buffer, 1);
+    buffer_len = 0;
+}
+
+void SM3::digest(uint8_t out[32]) const {
+    for (int i = 0; i < 8; ++i) {
+        store_be32(out + 4 * i, state[i]);
+    }
+}
+
+string SM3::digest() const {
+    uint8_t out[32];
+    digest(out);
+    return sm3_to_hex(out);
+}
+
+string sm3_to_hex(const uint8_t digest[32]) {
+    static const char hex_digits[] = "0123456789abcdef";
+    string s(64, '0');
+    for (int i = 0; i < 32; ++i) {
+        s[2 * i] = hex_digits[digest[i] >> 4];
+        s[2 * i + 1] = hex_digits[digest[i] & 0x0F];
+    }
+    return s;
+}
+
+// 压缩一个分组：消息扩展得到W与W'，再进行64轮迭代
+static void compress_block(uint32_t state[8], const uint8_t* block) {
+    uint32_t W[68];
+    uint32_t W1[64];
+
+    // 加载前16个字 - 使用大端序加载
+    for (int i = 0; i < 16; ++i) {
+        W[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+            (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+            (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+            static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+
+    // 消息扩展 - 展开循环减少分支
+    for (int j = 16; j < 68; j += 4) {
+        W[j] = P1(W[j - 16] ^ W[j - 9] ^ ROL(W[j - 3], 15)) ^ ROL(W[j - 13], 7) ^ W[j - 6];
+        W[j + 1] = P1(W[j - 15] ^ W[j - 8] ^ ROL(W[j - 2], 15)) ^ ROL(W[j - 12], 7) ^ W[j - 5];
+        W[j + 2] = P1(W[j - 14] ^ W[j - 7] ^ ROL(W[j - 1], 15)) ^ ROL(W[j - 11], 7) ^ W[j - 4];
+        W[j + 3] = P1(W[j - 13] ^ W[j - 6] ^ ROL(W[j], 15)) ^ ROL(W[j - 10], 7) ^ W[j - 3];
+    }
+
+    // 计算W'
+    for (int j = 0; j < 64; j += 4) {
+        W1[j] = W[j] ^ W[j + 4];
+        W1[j + 1] = W[j + 1] ^ W[j + 5];
+        W1[j + 2] = W[j + 2] ^ W[j + 6];
+        W1[j + 3] = W[j + 3] ^ W[j + 7];
+    }
+
+    uint32_t A = state[0];
+    uint32_t B = state[1];
+    uint32_t C = state[2];
+    uint32_t D = state[3];
+    uint32_t E = state[4];
+    uint32_t F = state[5];
+    uint32_t G = state[6];
+    uint32_t H = state[7];
+
+    // 前16轮
+    for (int j = 0; j < 16; ++j) {
+        uint32_t A_rot12 = ROL(A, 12);
+        uint32_t SS1 = ROL(A_rot12 + E + ROL(T0, j), 7);
+        uint32_t SS2 = SS1 ^ A_rot12;
+
+        uint32_t TT1 = FF0(A, B, C) + D + SS2 + W1[j];
+        uint32_t TT2 = GG0(E, F, G) + H + SS1 + W[j];
+
+        D = C;
+        C = ROL(B, 9);
+        B = A;
+        A = TT1;
+        H = G;
+        G = ROL(F, 19);
+        F = E;
+        E = P0(TT2);
+    }
+
+    // 后48轮
+    for (int j = 16; j < 64; ++j) {
+        uint32_t A_rot12 = ROL(A, 12);
+        uint32_t SS1 = ROL(A_rot12 + E + ROL(T1, j), 7);
+        uint32_t SS2 = SS1 ^ A_rot12;
+
+        uint32_t TT1 = FF1(A, B, C) + D + SS2 + W1[j];
+        uint32_t TT2 = GG1(E, F, G) + H + SS1 + W[j];
+
+        D = C;
+        C = ROL(B, 9);
+        B = A;
+        A = TT1;
+        H = G;
+        G = ROL(F, 19);
+        F = E;
+        E = P0(TT2);
+    }
+
+    state[0] ^= A;
+    state[1] ^= B;
+    state[2] ^= C;
+    state[3] ^= D;
+    state[4] ^= E;
+    state[5] ^= F;
+    state[6] ^= G;
+    state[7] ^= H;
+}
+
+void sm3_compress_scalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for (; blocks; blocks--, data += 64) {
+        compress_block(state, data);
+    }
+}
+
+// 可供选择的单条消息实现，按优先级从高到低排列
+struct sm3_kernel {
+    const char* name;
+    void (*fn)(uint32_t state[8], const uint8_t* data, size_t blocks);
+    bool (*available)();
+};
+
+static bool always() { return true; }
+static bool has_ssse3() { return sm3_cpu().ssse3; }
+
+static const sm3_kernel kernels[] = {
+    { "ssse3", sm3_compress_ssse3, has_ssse3 },
+    { "scalar", sm3_compress_scalar, always },
+};
+static const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static const sm3_kernel* find_kernel(const char* name) {
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (strcmp(kernels[i].name, name) == 0) return &kernels[i];
+    }
+    return nullptr;
+}
+
+// 启动时选择：环境变量SM3_IMPL可强制指定实现（用于基准测试），否则选可用的最快实现
+static const sm3_kernel* select_kernel() {
+    const char* env = getenv("SM3_IMPL");
+    if (env && *env && strcmp(env, "auto") != 0) {
+        const sm3_kernel* k = find_kernel(env);
+        if (k && k->available()) return k;
+        fprintf(stderr, "SM3_IMPL=%s is not available on this CPU, using auto selection\n", env);
+    }
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (kernels[i].available()) return &kernels[i];
+    }
+    return &kernels[kernel_count - 1];
+}
+
+// 原子指针，理由同project1/sm4_dispatch.cpp中的active_slot
+static atomic<const sm3_kernel*>& active_slot() {
+    static atomic<const sm3_kernel*> active{ select_kernel() };
+    return active;
+}
+
+static const sm3_kernel* active_kernel() {
+    return active_slot().load(memory_order_relaxed);
+}
+
+const char* sm3_impl_name() {
+    return active_kernel()->name;
+}
+
+bool sm3_set_impl(const char* name) {
+    const sm3_kernel* k = find_kernel(name);
+    if (!k || !k->available()) return false;
+    active_slot().store(k, memory_order_relaxed);
+    return true;
+}
+
+void sm3_compress(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    active_kernel()->fn(state, data, blocks);
+}
+
+void SM3::process_blocks(const uint8_t* data, size_t blocks) {
+    PROBE(PROBE_SM3_BLOCK, 64 * blocks, blocks);
+    sm3_compress(state, data, blocks);
+}
+
+void sm3_hash(const uint8_t* data, size_t len, uint8_t out[32]) {
+    SM3 sm3;
+    sm3.update(data, len);
+    sm3.finalize();
+    sm3.digest(out);
+}
+
+string sm3_hash(const string& input) {
+    SM3 sm3;
+    sm3.update(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    sm3.finalize();
+    return sm3.digest();
+}
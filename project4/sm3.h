@@ -0,0 +1,77 @@
+﻿#pragma once
+// SM3杂凑算法（GB/T 32905-2016）：由project4-a.cpp中的SM3类整理成可复用的库，
+// 运算过程与project4-a.cpp相同
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SM3_X86 1
+#endif
+
+// 为一段代码单独开启指令集（GCC/Clang），MSVC下内建函数无需额外编译开关
+#define SM3_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define SM3_TARGET_BEGIN(isa) SM3_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define SM3_TARGET_END() SM3_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define SM3_TARGET_BEGIN(isa) SM3_PRAGMA(GCC push_options) SM3_PRAGMA(GCC target(isa))
+#define SM3_TARGET_END() SM3_PRAGMA(GCC pop_options)
+#else
+#define SM3_TARGET_BEGIN(isa)
+#define SM3_TARGET_END()
+#endif
+
+// CPU特性检测（cpuid + xgetbv），只在第一次调用时检测
+struct sm3_cpu_features {
+    bool ssse3;
+    bool avx2;
+    bool avx512;    // AVX-512F + AVX-512BW
+};
+const sm3_cpu_features& sm3_cpu();
+
+// SM3上下文：不足一组的数据放在对象内的定长缓冲区，update/finalize/digest(uint8_t*)都不分配堆内存。
+// 对象可平凡复制，复制一份即得到当前中间状态的克隆，两份可以分别继续update（例如共享前缀的多条消息）
+class SM3 {
+public:
+    SM3() { reset(); }
+
+    void reset();
+    void reset(const uint32_t iv[8], uint64_t prefix_len);  // 从已压缩prefix_len字节（64的倍数）后的链接值继续
+    void update(const uint8_t* data, size_t len);
+    void finalize();                        // 填充并处理最后的分组，之后可调用digest
+    void digest(uint8_t out[32]) const;     // 32字节二进制摘要
+    std::string digest() const;             // 十六进制摘要，即sm3_to_hex(digest)
+
+private:
+    void process_blocks(const uint8_t* data, size_t blocks);
+
+    alignas(64) uint8_t buffer[64];
+    size_t buffer_len;
+    uint32_t state[8];
+    uint64_t total_len;
+};
+static_assert(std::is_trivially_copyable<SM3>::value, "SM3 context must be trivially copyable");
+
+// 一次计算整段数据的摘要
+void sm3_hash(const uint8_t* data, size_t len, uint8_t out[32]);
+std::string sm3_hash(const std::string& input);
+
+// 32字节摘要转为64个小写十六进制字符
+std::string sm3_to_hex(const uint8_t digest[32]);
+
+// SM3的初始值
+extern const uint32_t SM3_IV[8];
+
+// 压缩函数：依次压缩data中blocks个64字节分组，使用当前选中的单条消息实现（SM3类与多路实现的尾部都使用它）
+void sm3_compress(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+// 各实现：scalar为project4-a.cpp的原始写法；ssse3用SSE做消息扩展并与标量轮函数交错，需要sm3_cpu().ssse3
+void sm3_compress_scalar(uint32_t state[8], const uint8_t* data, size_t blocks);
+void sm3_compress_ssse3(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+// 当前单条消息实现的名字；sm3_set_impl在运行时切换（ssse3|scalar），CPU不支持时返回false。
+// 也可用环境变量SM3_IMPL指定
+const char* sm3_impl_name();
+bool sm3_set_impl(const char* name);
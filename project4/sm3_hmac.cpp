@@ -0,0 +1,118 @@
+﻿#include "sm3_hmac.h"
+#include "sm3_mb.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// 清除内存中的密钥材料，volatile防止被编译器优化掉
+static void wipe(void* p, size_t n) {
+    volatile uint8_t* v = static_cast<volatile uint8_t*>(p);
+    while (n--) *v++ = 0;
+}
+
+// 常数时间比较，耗时与第一个不同字节的位置无关
+static bool equal_ct(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < n; i++) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+sm3_hmac_key::sm3_hmac_key(const uint8_t* key, size_t key_len) {
+    uint8_t k[64] = {};
+    if (key_len > 64) {
+        sm3_hash(key, key_len, k);
+    }
+    else if (key_len) {
+        memcpy(k, key, key_len);
+    }
+
+    uint8_t pad[64];
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    memcpy(istate, SM3_IV, sizeof(istate));
+    sm3_compress(istate, pad, 1);
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5C;
+    memcpy(ostate, SM3_IV, sizeof(ostate));
+    sm3_compress(ostate, pad, 1);
+
+    wipe(k, sizeof(k));
+    wipe(pad, sizeof(pad));
+}
+
+sm3_hmac_key::~sm3_hmac_key() {
+    wipe(istate, sizeof(istate));
+    wipe(ostate, sizeof(ostate));
+}
+
+void sm3_hmac_key::mac(const uint8_t* data, size_t len, uint8_t out[32]) const {
+    sm3_hmac h(*this);
+    h.update(data, len);
+    h.finalize(out);
+}
+
+bool sm3_hmac_key::verify(const uint8_t* data, size_t len, const uint8_t* tag, size_t tag_len) const {
+    if (tag_len == 0 || tag_len > 32) return false;
+    uint8_t expect[32];
+    mac(data, len, expect);
+    return equal_ct(expect, tag, tag_len);
+}
+
+sm3_hmac::sm3_hmac(const sm3_hmac_key& key) : key(key) {
+    inner.reset(key.inner_iv(), 64);
+}
+
+void sm3_hmac::update(const uint8_t* data, size_t len) {
+    inner.update(data, len);
+}
+
+// 外层只有32字节内层摘要，加上填充正好一个分组
+void sm3_hmac::finalize(uint8_t out[32]) {
+    uint8_t d[32];
+    inner.finalize();
+    inner.digest(d);
+    SM3 outer;
+    outer.reset(key.outer_iv(), 64);
+    outer.update(d, 32);
+    outer.finalize();
+    outer.digest(out);
+}
+
+// 每次最多CHUNK条消息在管理器中，sm3_job放在栈上。某条消息的内层完成后，
+// 把同一个sm3_job改成外层任务（输入为暂存在mac中的内层摘要）立即重新提交，与其他消息的内层一起压缩
+void sm3_hmac_batch(const sm3_hmac_key& key, sm3_hmac_job* jobs, size_t n) {
+    const size_t CHUNK = 128;
+    sm3_job mb[CHUNK];
+    sm3_mb_manager m;
+
+    auto handle = [&](sm3_job* j) {
+        while (j) {
+            sm3_hmac_job* hj = static_cast<sm3_hmac_job*>(j->user);
+            memcpy(hj->mac, j->digest, 32);
+            if (j->iv == key.outer_iv()) return;
+            j->data = hj->mac;
+            j->len = 32;
+            j->iv = key.outer_iv();
+            j = m.submit(j);
+        }
+    };
+
+    for (size_t base = 0; base < n; base += CHUNK) {
+        size_t count = min(CHUNK, n - base);
+        for (size_t i = 0; i < count; i++) {
+            sm3_hmac_job& hj = jobs[base + i];
+            mb[i] = sm3_job{ hj.data, hj.len, {}, &hj, key.inner_iv(), 64 };
+            handle(m.submit(&mb[i]));
+        }
+        while (sm3_job* j = m.flush()) handle(j);
+    }
+}
+
+size_t sm3_hmac_verify_batch(const sm3_hmac_key& key, sm3_hmac_job* jobs, size_t n) {
+    sm3_hmac_batch(key, jobs, n);
+    size_t passed = 0;
+    for (size_t i = 0; i < n; i++) {
+        jobs[i].ok = jobs[i].tag && equal_ct(jobs[i].mac, jobs[i].tag, 32);
+        passed += jobs[i].ok;
+    }
+    return passed;
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+// HMAC-SM3（RFC 2104，分组长度64字节，输出32字节）：
+// HMAC(K, m) = SM3((K ^ opad) || SM3((K ^ ipad) || m))。
+// K ^ ipad与K ^ opad恰好各占一个分组，密钥确定后它们压缩后的链接值也就确定了，
+// sm3_hmac_key在构造时把这两个分组压缩一次并保存，之后每次计算MAC只需压缩消息本身的分组
+// 加上内层的填充分组，再加外层的一个分组（32字节内层摘要 + 填充）
+#include "sm3.h"
+
+class sm3_hmac_key {
+public:
+    sm3_hmac_key(const uint8_t* key, size_t key_len);   // 超过64字节的密钥先用SM3压缩为32字节
+    ~sm3_hmac_key();                                    // 清除保存的链接值
+
+    void mac(const uint8_t* data, size_t len, uint8_t out[32]) const;
+    // 常数时间比较；tag_len可小于32（截断的MAC，比较前tag_len字节），为0或超过32时返回false
+    bool verify(const uint8_t* data, size_t len, const uint8_t* tag, size_t tag_len = 32) const;
+
+    // 压缩K ^ ipad / K ^ opad之后的链接值，已处理长度均为64字节
+    const uint32_t* inner_iv() const { return istate; }
+    const uint32_t* outer_iv() const { return ostate; }
+
+private:
+    uint32_t istate[8];
+    uint32_t ostate[8];
+};
+
+// 分多次输入消息的HMAC计算，从ipad链接值开始，不分配堆内存
+class sm3_hmac {
+public:
+    explicit sm3_hmac(const sm3_hmac_key& key);
+
+    void update(const uint8_t* data, size_t len);
+    void finalize(uint8_t out[32]);
+
+private:
+    const sm3_hmac_key& key;
+    SM3 inner;
+};
+
+// 同一密钥下的批量计算：内层与外层都交给多路SM3（sm3_mb_manager），各条消息同时计算
+struct sm3_hmac_job {
+    const uint8_t* data;
+    size_t len;
+    uint8_t mac[32];            // 完成后写入MAC
+    const uint8_t* tag;         // sm3_hmac_verify_batch使用：待验证的32字节MAC
+    bool ok;                    // sm3_hmac_verify_batch写入：tag是否正确
+};
+
+void sm3_hmac_batch(const sm3_hmac_key& key, sm3_hmac_job* jobs, size_t n);
+// 计算各任务的MAC并与tag常数时间比较，返回验证通过的条数
+size_t sm3_hmac_verify_batch(const sm3_hmac_key& key, sm3_hmac_job* jobs, size_t n);
@@ -0,0 +1,205 @@
+﻿#include "sm3_mb.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// 可供选择的多路内核，按优先级从高到低排列
+struct sm3_mb_kernel {
+    const char* name;
+    sm3_mb_fn fn;
+    size_t lanes;
+    bool (*available)();
+};
+
+// 单路：直接调用标量压缩函数，state的布局与sm3_compress相同
+static void compress_x1(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    sm3_compress(state, data[0], blocks);
+}
+
+static bool always() { return true; }
+static bool has_avx2() { return sm3_cpu().avx2; }
+static bool has_avx512() { return sm3_cpu().avx512; }
+
+static const sm3_mb_kernel kernels[] = {
+    { "avx512-x16", sm3_compress_x16_avx512, 16, has_avx512 },
+    { "avx2-x8", sm3_compress_x8_avx2, 8, has_avx2 },
+    { "scalar", compress_x1, 1, always },
+};
+static const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static const sm3_mb_kernel* find_kernel(const char* name) {
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (strcmp(kernels[i].name, name) == 0) return &kernels[i];
+    }
+    return nullptr;
+}
+
+// 启动时选择：环境变量SM3_MB_IMPL可强制指定内核（用于基准测试），否则选可用的最快内核
+static const sm3_mb_kernel* select_kernel() {
+    const char* env = getenv("SM3_MB_IMPL");
+    if (env && *env && strcmp(env, "auto") != 0) {
+        const sm3_mb_kernel* k = find_kernel(env);
+        if (k && k->available()) return k;
+        fprintf(stderr, "SM3_MB_IMPL=%s is not available on this CPU, using auto selection\n", env);
+    }
+    for (size_t i = 0; i < kernel_count; i++) {
+        if (kernels[i].available()) return &kernels[i];
+    }
+    return &kernels[kernel_count - 1];
+}
+
+// 原子指针，理由同project1/sm4_dispatch.cpp中的active_slot
+static atomic<const sm3_mb_kernel*>& active_slot() {
+    static atomic<const sm3_mb_kernel*> active{ select_kernel() };
+    return active;
+}
+
+static const sm3_mb_kernel* active_kernel() {
+    return active_slot().load(memory_order_relaxed);
+}
+
+const char* sm3_mb_impl_name() {
+    return active_kernel()->name;
+}
+
+size_t sm3_mb_lanes() {
+    return active_kernel()->lanes;
+}
+
+bool sm3_mb_set_impl(const char* name) {
+    const sm3_mb_kernel* k = find_kernel(name);
+    if (!k || !k->available()) return false;
+    active_slot().store(k, memory_order_relaxed);
+    return true;
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+sm3_mb_manager::sm3_mb_manager() : active(0), done_head(0), done_count(0) {
+    // 只读取一次当前内核，保证fn与路数来自同一个内核
+    const sm3_mb_kernel* k = active_kernel();
+    fn = k->fn;
+    n_lanes = k->lanes;
+    memset(state, 0, sizeof(state));
+    for (size_t l = 0; l < MAX_LANES; l++) slots[l].job = nullptr;
+}
+
+sm3_job* sm3_mb_manager::submit(sm3_job* job) {
+    size_t l = 0;
+    while (slots[l].job) l++;      // active < n_lanes时必有空闲的路
+
+    // 数据部分直接从调用方的缓冲区读取，不足一组的尾部与填充、长度放进该路自己的填充缓冲
+    slot& s = slots[l];
+    size_t full = job->len / 64, tail = job->len % 64;
+    s.job = job;
+    s.pad_blocks = tail < 56 ? 1 : 2;
+    if (tail) memcpy(s.pad, job->data + 64 * full, tail);
+    s.pad[tail] = 0x80;
+    memset(s.pad + tail + 1, 0, 64 * s.pad_blocks - 8 - tail - 1);
+    uint64_t bits = (job->prefix_len + job->len) * 8;
+    uint8_t* end = s.pad + 64 * s.pad_blocks;
+    store_be32(end - 8, (uint32_t)(bits >> 32));
+    store_be32(end - 4, (uint32_t)bits);
+    if (full) {
+        s.ptr = job->data;
+        s.left = full;
+    }
+    else {
+        s.ptr = s.pad;
+        s.left = s.pad_blocks;
+        s.pad_blocks = 0;
+    }
+    const uint32_t* iv = job->iv ? job->iv : SM3_IV;
+    for (int i = 0; i < 8; i++) state[i * n_lanes + l] = iv[i];
+
+    if (++active == n_lanes) run();
+    return pop_done();
+}
+
+sm3_job* sm3_mb_manager::flush() {
+    if (done_count == 0 && active > 0) run();
+    return pop_done();
+}
+
+sm3_job* sm3_mb_manager::pop_done() {
+    if (done_count == 0) return nullptr;
+    sm3_job* r = done[done_head];
+    done_head = (done_head + 1) % MAX_LANES;
+    done_count--;
+    return r;
+}
+
+// 压缩到至少一路完成为止。空闲的路借用某个活动路的数据指针，结果丢弃；
+// flush阶段只剩少数几路时，向量内核的大部分通道空转，改为逐路调用标量压缩
+void sm3_mb_manager::run() {
+    while (done_count == 0) {
+        if (active <= n_lanes / 4) {
+            for (size_t l = 0; l < n_lanes; l++) {
+                if (slots[l].job) finish_scalar(l);
+            }
+            return;
+        }
+
+        size_t n = SIZE_MAX;
+        const uint8_t* spare = nullptr;
+        for (size_t l = 0; l < n_lanes; l++) {
+            if (slots[l].job && slots[l].left < n) {
+                n = slots[l].left;
+                spare = slots[l].ptr;
+            }
+        }
+        const uint8_t* ptrs[MAX_LANES];
+        for (size_t l = 0; l < n_lanes; l++) ptrs[l] = slots[l].job ? slots[l].ptr : spare;
+        fn(state, ptrs, n);
+
+        for (size_t l = 0; l < n_lanes; l++) {
+            slot& s = slots[l];
+            if (!s.job) continue;
+            s.ptr += 64 * n;
+            s.left -= n;
+            if (s.left) continue;
+            if (s.pad_blocks) {
+                s.ptr = s.pad;
+                s.left = s.pad_blocks;
+                s.pad_blocks = 0;
+            }
+            else {
+                complete(l);
+            }
+        }
+    }
+}
+
+void sm3_mb_manager::finish_scalar(size_t l) {
+    slot& s = slots[l];
+    uint32_t v[8];
+    for (int i = 0; i < 8; i++) v[i] = state[i * n_lanes + l];
+    sm3_compress(v, s.ptr, s.left);
+    if (s.pad_blocks) sm3_compress(v, s.pad, s.pad_blocks);
+    for (int i = 0; i < 8; i++) state[i * n_lanes + l] = v[i];
+    complete(l);
+}
+
+void sm3_mb_manager::complete(size_t l) {
+    slot& s = slots[l];
+    for (int i = 0; i < 8; i++) store_be32(s.job->digest + 4 * i, state[i * n_lanes + l]);
+    done[(done_head + done_count) % MAX_LANES] = s.job;
+    done_count++;
+    s.job = nullptr;
+    active--;
+}
+
+void sm3_hash_batch(sm3_job* jobs, size_t n) {
+    sm3_mb_manager m;
+    for (size_t i = 0; i < n; i++) m.submit(&jobs[i]);
+    while (m.flush()) {
+    }
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+// 多路（multi-buffer）SM3：大量互不相关的短消息（Merkle树叶子、记录、文件分块）同时计算，
+// 每条消息占一路向量通道，一次压缩各路的一个分组（AVX-512为16路，AVX2为8路）
+#include "sm3.h"
+
+struct sm3_job {
+    const uint8_t* data;
+    size_t len;
+    uint8_t digest[32];     // 完成后写入二进制摘要
+    void* user;             // 调用方自用，管理器不访问
+    const uint32_t* iv = nullptr;   // 非空时从该链接值开始（例如HMAC预先压缩的ipad/opad），否则用SM3_IV
+    uint64_t prefix_len = 0;        // iv之前已压缩的字节数（64的倍数），计入填充中的消息长度
+};
+
+// 多路压缩内核：state按[字][路]存放（state[i * lanes + l]为第l路的第i个状态字），
+// data[l]指向第l路连续的blocks个分组
+typedef void (*sm3_mb_fn)(uint32_t* state, const uint8_t* const* data, size_t blocks);
+void sm3_compress_x8_avx2(uint32_t* state, const uint8_t* const* data, size_t blocks);
+void sm3_compress_x16_avx512(uint32_t* state, const uint8_t* const* data, size_t blocks);
+
+// 当前多路内核的名字与路数；sm3_mb_set_impl在运行时切换（avx512-x16|avx2-x8|scalar），CPU不支持时返回false。
+// 也可用环境变量SM3_MB_IMPL指定
+const char* sm3_mb_impl_name();
+size_t sm3_mb_lanes();
+bool sm3_mb_set_impl(const char* name);
+
+// 任务调度：submit把任务放入空闲的路，所有路都被占用时一起压缩，直到至少一路的消息处理完；
+// 返回一个已完成的任务（没有则返回nullptr）。各路长度不同，每次压缩各路剩余分组数的最小值，
+// 处理完数据部分的路接着压缩自己的填充分组。flush在没有新任务时处理剩余的路，
+// 每次返回一个已完成的任务，全部完成后返回nullptr。
+// 任务在返回之前必须保持有效；管理器使用构造时选中的内核，不可多线程共用
+class sm3_mb_manager {
+public:
+    sm3_mb_manager();
+    sm3_mb_manager(const sm3_mb_manager&) = delete;     // 各路的指针可能指向自身的填充缓冲
+    sm3_mb_manager& operator=(const sm3_mb_manager&) = delete;
+
+    sm3_job* submit(sm3_job* job);
+    sm3_job* flush();
+
+    size_t lanes() const { return n_lanes; }
+
+    static const size_t MAX_LANES = 16;
+
+private:
+    struct slot {
+        sm3_job* job;
+        const uint8_t* ptr;             // 当前段的下一个分组
+        size_t left;                    // 当前段剩余分组数
+        size_t pad_blocks;              // 数据段之后的填充分组数（1或2），进入填充段后为0
+        alignas(16) uint8_t pad[128];   // 不足一组的尾部 + 填充 + 长度
+    };
+
+    void run();
+    void finish_scalar(size_t l);
+    void complete(size_t l);
+    sm3_job* pop_done();
+
+    sm3_mb_fn fn;
+    size_t n_lanes;
+    size_t active;
+    alignas(64) uint32_t state[8 * MAX_LANES];
+    slot slots[MAX_LANES];
+    sm3_job* done[MAX_LANES];           // 已完成、尚未返回的任务（环形队列）
+    size_t done_head, done_count;
+};
+
+// 计算n条消息的摘要：依次提交给多路管理器，最后flush
+void sm3_hash_batch(sm3_job* jobs, size_t n);
@@ -0,0 +1,94 @@
+﻿#include "sm3_mb.h"
+
+#if defined(SM3_X86)
+#include <immintrin.h>
+
+using namespace std;
+
+SM3_TARGET_BEGIN("avx2")
+
+// AVX2版本：每个__m256i存放8路消息的同一个字。AVX2没有32位循环移位指令，用两次移位和一次或实现
+typedef __m256i mb_word;
+#define MB_LANES 8
+
+static inline mb_word mb_add(mb_word a, mb_word b) { return _mm256_add_epi32(a, b); }
+static inline mb_word mb_xor(mb_word a, mb_word b) { return _mm256_xor_si256(a, b); }
+static inline mb_word mb_set1(uint32_t v) { return _mm256_set1_epi32((int)v); }
+static inline mb_word mb_load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void mb_store(uint32_t* p, mb_word a) { _mm256_storeu_si256((__m256i*)p, a); }
+#define mb_rol(a, n) _mm256_or_si256(_mm256_slli_epi32((a), (n)), _mm256_srli_epi32((a), 32 - (n)))
+
+static inline mb_word mb_xor3(mb_word a, mb_word b, mb_word c) { return mb_xor(mb_xor(a, b), c); }
+// (X & Y) | (X & Z) | (Y & Z) = (X & Y) | ((X | Y) & Z)
+static inline mb_word mb_ff1(mb_word x, mb_word y, mb_word z) {
+    return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(_mm256_or_si256(x, y), z));
+}
+// (X & Y) | (~X & Z) = ((Y ^ Z) & X) ^ Z
+static inline mb_word mb_gg1(mb_word x, mb_word y, mb_word z) {
+    return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(y, z), x), z);
+}
+
+// 8路各8个字的8x8转置：输入r[l]为第l路的字0..7，输出w[i]为8路的字i
+static inline void transpose8(const __m256i r[8], mb_word* w) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    w[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    w[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    w[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    w[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    w[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    w[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    w[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    w[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+static inline void mb_load_message(const uint8_t* const* data, size_t off, mb_word W[16]) {
+    const __m256i bswap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (int half = 0; half < 2; half++) {
+        __m256i r[8];
+        for (int l = 0; l < 8; l++) {
+            r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data[l] + off + 32 * half)), bswap);
+        }
+        transpose8(r, W + 8 * half);
+    }
+}
+
+#include "sm3_mb_impl.h"
+
+void sm3_compress_x8_avx2(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    mb_compress(state, data, blocks);
+}
+
+SM3_TARGET_END()
+
+#else
+
+// 非x86平台逐路调用标量压缩函数
+void sm3_compress_x8_avx2(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    for (int l = 0; l < 8; l++) {
+        uint32_t v[8];
+        for (int i = 0; i < 8; i++) v[i] = state[i * 8 + l];
+        sm3_compress(v, data[l], blocks);
+        for (int i = 0; i < 8; i++) state[i * 8 + l] = v[i];
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+﻿#include "sm3_mb.h"
+
+#if defined(SM3_X86)
+#include "../common/intrin.h"
+
+using namespace std;
+
+SM3_TARGET_BEGIN("avx512f,avx512bw")
+
+// AVX-512版本：每个__m512i存放16路消息的同一个字。
+// 循环移位直接用vprold；三输入的异或、FF1（多数函数）、GG1（按X选择Y或Z）以及P0/P1中的异或各用一条vpternlogd
+typedef __m512i mb_word;
+#define MB_LANES 16
+
+static inline mb_word mb_add(mb_word a, mb_word b) { return _mm512_add_epi32(a, b); }
+static inline mb_word mb_xor(mb_word a, mb_word b) { return _mm512_xor_si512(a, b); }
+static inline mb_word mb_set1(uint32_t v) { return _mm512_set1_epi32((int)v); }
+static inline mb_word mb_load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+static inline void mb_store(uint32_t* p, mb_word a) { _mm512_storeu_si512(p, a); }
+#define mb_rol(a, n) _mm512_rol_epi32((a), (n))
+
+static inline mb_word mb_xor3(mb_word a, mb_word b, mb_word c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+static inline mb_word mb_ff1(mb_word x, mb_word y, mb_word z) { return _mm512_ternarylogic_epi32(x, y, z, 0xE8); }
+static inline mb_word mb_gg1(mb_word x, mb_word y, mb_word z) { return _mm512_ternarylogic_epi32(x, y, z, 0xCA); }
+
+// 16路各16个字的16x16转置：输入r[l]为第l路的字0..15，输出w[i]为16路的字i
+static inline void transpose16(const __m512i r[16], mb_word* w) {
+    // 每个128位通道内先做4x4转置：u[4k+m]的第q个128位通道是第4k..4k+3路的字4q+m
+    __m512i t[16], u[16];
+    for (int k = 0; k < 8; k++) {
+        t[2 * k] = _mm512_unpacklo_epi32(r[2 * k], r[2 * k + 1]);
+        t[2 * k + 1] = _mm512_unpackhi_epi32(r[2 * k], r[2 * k + 1]);
+    }
+    for (int k = 0; k < 4; k++) {
+        u[4 * k] = _mm512_unpacklo_epi64(t[4 * k], t[4 * k + 2]);
+        u[4 * k + 1] = _mm512_unpackhi_epi64(t[4 * k], t[4 * k + 2]);
+        u[4 * k + 2] = _mm512_unpacklo_epi64(t[4 * k + 1], t[4 * k + 3]);
+        u[4 * k + 3] = _mm512_unpackhi_epi64(t[4 * k + 1], t[4 * k + 3]);
+    }
+    // 再在128位通道之间做4x4转置
+    for (int m = 0; m < 4; m++) {
+        __m512i x0 = _mm512_shuffle_i32x4(u[m], u[4 + m], 0x44);
+        __m512i x1 = _mm512_shuffle_i32x4(u[m], u[4 + m], 0xEE);
+        __m512i y0 = _mm512_shuffle_i32x4(u[8 + m], u[12 + m], 0x44);
+        __m512i y1 = _mm512_shuffle_i32x4(u[8 + m], u[12 + m], 0xEE);
+        w[m] = _mm512_shuffle_i32x4(x0, y0, 0x88);
+        w[4 + m] = _mm512_shuffle_i32x4(x0, y0, 0xDD);
+        w[8 + m] = _mm512_shuffle_i32x4(x1, y1, 0x88);
+        w[12 + m] = _mm512_shuffle_i32x4(x1, y1, 0xDD);
+    }
+}
+
+static inline void mb_load_message(const uint8_t* const* data, size_t off, mb_word W[16]) {
+    const __m512i bswap = _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    __m512i r[16];
+    for (int l = 0; l < 16; l++) {
+        r[l] = _mm512_shuffle_epi8(_mm512_loadu_si512(data[l] + off), bswap);
+    }
+    transpose16(r, W);
+}
+
+#include "sm3_mb_impl.h"
+
+void sm3_compress_x16_avx512(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    mb_compress(state, data, blocks);
+}
+
+SM3_TARGET_END()
+
+#else
+
+// 非x86平台逐路调用标量压缩函数
+void sm3_compress_x16_avx512(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    for (int l = 0; l < 16; l++) {
+        uint32_t v[8];
+        for (int i = 0; i < 8; i++) v[i] = state[i * 16 + l];
+        sm3_compress(v, data[l], blocks);
+        for (int i = 0; i < 8; i++) state[i * 16 + l] = v[i];
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+﻿// 多路SM3压缩的通用实现，由各指令集的源文件在定义以下类型和操作后包含：
+//   mb_word                       每个通道一个32位字的向量，MB_LANES为通道数
+//   mb_add / mb_xor / mb_set1 / mb_load / mb_store
+//   mb_rol(a, n)                  循环左移（宏，n为常量）
+//   mb_xor3 / mb_ff1 / mb_gg1     三输入异或与第16～63轮的布尔函数
+//   mb_load_message(data, off, W) 读入各路偏移off处的分组，转置为W[0..15]（已按大端序转换）
+// 本文件不单独编译
+
+// 各轮常量T_j <<< j
+static constexpr uint32_t mb_rol_const(uint32_t x, int n) {
+    return n % 32 == 0 ? x : (x << (n % 32)) | (x >> (32 - n % 32));
+}
+
+struct mb_tj_table {
+    uint32_t v[64];
+    constexpr mb_tj_table() : v() {
+        for (int j = 0; j < 64; j++) v[j] = mb_rol_const(j < 16 ? 0x79CC4519 : 0x7A879D8A, j);
+    }
+};
+static constexpr mb_tj_table MB_TJ{};
+
+static inline mb_word mb_p0(mb_word x) { return mb_xor3(x, mb_rol(x, 9), mb_rol(x, 17)); }
+static inline mb_word mb_p1(mb_word x) { return mb_xor3(x, mb_rol(x, 15), mb_rol(x, 23)); }
+static inline mb_word mb_ff0(mb_word x, mb_word y, mb_word z) { return mb_xor3(x, y, z); }
+static inline mb_word mb_gg0(mb_word x, mb_word y, mb_word z) { return mb_xor3(x, y, z); }
+
+// 一轮迭代。不移动8个状态变量，而是把TT1写入D、P0(TT2)写入H，并原地旋转B、F，
+// 下一轮按(D, A, B, C, H, E, F, G)的顺序传入，4轮后恢复原来的命名
+#define MB_ROUND(j, A, B, C, D, E, F, G, H, FF, GG) do {                        \
+        mb_word a12 = mb_rol(A, 12);                                            \
+        mb_word ss1 = mb_rol(mb_add(mb_add(a12, E), mb_set1(MB_TJ.v[j])), 7);   \
+        mb_word ss2 = mb_xor(ss1, a12);                                         \
+        mb_word w1 = mb_xor(W[j], W[(j) + 4]);                                  \
+        mb_word tt1 = mb_add(mb_add(FF(A, B, C), D), mb_add(ss2, w1));          \
+        mb_word tt2 = mb_add(mb_add(GG(E, F, G), H), mb_add(ss1, W[j]));        \
+        B = mb_rol(B, 9);                                                       \
+        F = mb_rol(F, 19);                                                      \
+        D = tt1;                                                                \
+        H = mb_p0(tt2);                                                         \
+    } while (0)
+
+#define MB_ROUND4(j, FF, GG) do {                                   \
+        MB_ROUND((j), A, B, C, D, E, F, G, H, FF, GG);              \
+        MB_ROUND((j) + 1, D, A, B, C, H, E, F, G, FF, GG);          \
+        MB_ROUND((j) + 2, C, D, A, B, G, H, E, F, FF, GG);          \
+        MB_ROUND((j) + 3, B, C, D, A, F, G, H, E, FF, GG);          \
+    } while (0)
+
+static void mb_compress(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    mb_word V[8];
+    for (int i = 0; i < 8; i++) V[i] = mb_load(state + i * MB_LANES);
+
+    for (size_t b = 0; b < blocks; b++) {
+        mb_word W[68];
+        mb_load_message(data, 64 * b, W);
+        for (int j = 16; j < 68; j++) {
+            W[j] = mb_xor3(mb_p1(mb_xor3(W[j - 16], W[j - 9], mb_rol(W[j - 3], 15))),
+                mb_rol(W[j - 13], 7), W[j - 6]);
+        }
+
+        mb_word A = V[0], B = V[1], C = V[2], D = V[3];
+        mb_word E = V[4], F = V[5], G = V[6], H = V[7];
+        for (int j = 0; j < 16; j += 4) MB_ROUND4(j, mb_ff0, mb_gg0);
+        for (int j = 16; j < 64; j += 4) MB_ROUND4(j, mb_ff1, mb_gg1);
+
+        V[0] = mb_xor(V[0], A);
+        V[1] = mb_xor(V[1], B);
+        V[2] = mb_xor(V[2], C);
+        V[3] = mb_xor(V[3], D);
+        V[4] = mb_xor(V[4], E);
+        V[5] = mb_xor(V[5], F);
+        V[6] = mb_xor(V[6], G);
+        V[7] = mb_xor(V[7], H);
+    }
+
+    for (int i = 0; i < 8; i++) mb_store(state + i * MB_LANES, V[i]);
+}
+
+#undef MB_ROUND4
+#undef MB_ROUND
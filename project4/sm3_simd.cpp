@@ -0,0 +1,155 @@
+﻿#include "sm3.h"
+
+#if defined(SM3_X86)
+#include <immintrin.h>
+
+using namespace std;
+
+// 各轮常量T_j <<< j
+static constexpr uint32_t rol_const(uint32_t x, int n) {
+    return n % 32 == 0 ? x : (x << (n % 32)) | (x >> (32 - n % 32));
+}
+
+struct tj_table {
+    uint32_t v[64];
+    constexpr tj_table() : v() {
+        for (int j = 0; j < 64; j++) v[j] = rol_const(j < 16 ? 0x79CC4519 : 0x7A879D8A, j);
+    }
+};
+static constexpr tj_table TJ{};
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define FF0(X, Y, Z) ((X) ^ (Y) ^ (Z))
+#define FF1(X, Y, Z) (((X) & (Y)) | (((X) | (Y)) & (Z)))
+#define GG0(X, Y, Z) ((X) ^ (Y) ^ (Z))
+#define GG1(X, Y, Z) ((((Y) ^ (Z)) & (X)) ^ (Z))
+#define P0(X) ((X) ^ ROL32(X, 9) ^ ROL32(X, 17))
+
+// 标量的一轮迭代，W'_j = W_j ^ W_{j+4}在使用时现算。与多路实现一样不移动状态变量，
+// TT1写入D、P0(TT2)写入H，并原地旋转B、F，下一轮按(D, A, B, C, H, E, F, G)的顺序传入
+#define ROUND(j, A, B, C, D, E, F, G, H, FF, GG) do {              \
+        uint32_t a12 = ROL32(A, 12);                                \
+        uint32_t ss1 = a12 + E + TJ.v[j];                           \
+        ss1 = ROL32(ss1, 7);                                        \
+        uint32_t ss2 = ss1 ^ a12;                                   \
+        uint32_t w = W[j];                                          \
+        D = FF(A, B, C) + D + ss2 + (w ^ W[(j) + 4]);               \
+        H = GG(E, F, G) + H + ss1 + w;                              \
+        H = P0(H);                                                  \
+        B = ROL32(B, 9);                                            \
+        F = ROL32(F, 19);                                           \
+    } while (0)
+
+#define ROUND4(j, FF, GG) do {                                      \
+        ROUND((j), A, B, C, D, E, F, G, H, FF, GG);                 \
+        ROUND((j) + 1, D, A, B, C, H, E, F, G, FF, GG);             \
+        ROUND((j) + 2, C, D, A, B, G, H, E, F, FF, GG);             \
+        ROUND((j) + 3, B, C, D, A, F, G, H, E, FF, GG);             \
+    } while (0)
+
+SM3_TARGET_BEGIN("ssse3")
+
+static inline __m128i rol(__m128i x, int n) {
+    return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+static inline __m128i xor3(__m128i a, __m128i b, __m128i c) {
+    return _mm_xor_si128(_mm_xor_si128(a, b), c);
+}
+
+static inline __m128i p1(__m128i x) {
+    return xor3(x, rol(x, 15), rol(x, 23));
+}
+
+// 由W[j-16..j-1]（w16、w12、w8、w4各4个字）计算W[j..j+3]。
+// W[j+3]依赖本组的W[j]：先把该项当作0算出4个字，由于P1是线性的（只含循环移位和异或），
+// 再把P1(W[j] <<< 15)异或到第4个字上即可
+static inline __m128i expand4(__m128i w16, __m128i w12, __m128i w8, __m128i w4) {
+    __m128i m9 = _mm_alignr_epi8(w8, w12, 12);      // W[j-9..j-6]
+    __m128i m13 = _mm_alignr_epi8(w12, w16, 12);    // W[j-13..j-10]
+    __m128i m6 = _mm_alignr_epi8(w4, w8, 8);        // W[j-6..j-3]
+    __m128i m3 = _mm_srli_si128(w4, 4);             // W[j-3..j-1], 0
+    __m128i w = xor3(p1(xor3(w16, m9, rol(m3, 15))), rol(m13, 7), m6);
+    __m128i fix = rol(_mm_slli_si128(w, 12), 15);   // 0, 0, 0, W[j] <<< 15
+    return _mm_xor_si128(w, p1(fix));
+}
+
+// 单条消息的压缩：大端序转换用pshufb，消息扩展每次用SSE算4个字，
+// 比标量轮函数提前3组进行，两者之间没有数据依赖，乱序执行时向量单元与标量单元同时工作
+void sm3_compress_ssse3(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    alignas(16) uint32_t W[68];
+
+    uint32_t A = state[0], B = state[1], C = state[2], D = state[3];
+    uint32_t E = state[4], F = state[5], G = state[6], H = state[7];
+
+    for (; blocks; blocks--, data += 64) {
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), bswap);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), bswap);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), bswap);
+        _mm_store_si128((__m128i*)W, w0);
+        _mm_store_si128((__m128i*)(W + 4), w1);
+        _mm_store_si128((__m128i*)(W + 8), w2);
+        _mm_store_si128((__m128i*)(W + 12), w3);
+
+        uint32_t A0 = A, B0 = B, C0 = C, D0 = D, E0 = E, F0 = F, G0 = G, H0 = H;
+
+        // 第g组4轮用到W[4g..4g+7]；第g组同时算出W[4g+16..4g+19]
+#define EXPAND(g) do {                                                  \
+            __m128i w4 = expand4(w0, w1, w2, w3);                       \
+            _mm_store_si128((__m128i*)(W + 4 * (g) + 16), w4);          \
+            w0 = w1;                                                    \
+            w1 = w2;                                                    \
+            w2 = w3;                                                    \
+            w3 = w4;                                                    \
+        } while (0)
+
+        EXPAND(0);  ROUND4(0, FF0, GG0);
+        EXPAND(1);  ROUND4(4, FF0, GG0);
+        EXPAND(2);  ROUND4(8, FF0, GG0);
+        EXPAND(3);  ROUND4(12, FF0, GG0);
+        EXPAND(4);  ROUND4(16, FF1, GG1);
+        EXPAND(5);  ROUND4(20, FF1, GG1);
+        EXPAND(6);  ROUND4(24, FF1, GG1);
+        EXPAND(7);  ROUND4(28, FF1, GG1);
+        EXPAND(8);  ROUND4(32, FF1, GG1);
+        EXPAND(9);  ROUND4(36, FF1, GG1);
+        EXPAND(10); ROUND4(40, FF1, GG1);
+        EXPAND(11); ROUND4(44, FF1, GG1);
+        EXPAND(12); ROUND4(48, FF1, GG1);
+        ROUND4(52, FF1, GG1);
+        ROUND4(56, FF1, GG1);
+        ROUND4(60, FF1, GG1);
+#undef EXPAND
+
+        A ^= A0;
+        B ^= B0;
+        C ^= C0;
+        D ^= D0;
+        E ^= E0;
+        F ^= F0;
+        G ^= G0;
+        H ^= H0;
+    }
+
+    state[0] = A;
+    state[1] = B;
+    state[2] = C;
+    state[3] = D;
+    state[4] = E;
+    state[5] = F;
+    state[6] = G;
+    state[7] = H;
+}
+
+SM3_TARGET_END()
+
+#else
+
+// 非x86平台退回标量实现
+void sm3_compress_ssse3(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    sm3_compress_scalar(state, data, blocks);
+}
+
+#endif